@@ -2,177 +2,39 @@
 //
 #include "pin.H"
 #include <set>
+#include <map>
+#include <algorithm>
+#include <vector>
 #include <fstream>
 #include <iostream>
 #include <assert.h>
 
-#define KB(x) ((x)*1024)
-#define MB(x) ((x)*1024*1024)
+#include "cachesim.h"
+#include "addressstore.h"
+#include "footprint.h"
+#include "tlb.h"
+#include "dram.h"
+#include "linesize.h"
+#include "selfprofile.h"
 
-#define ASSERTM(condition, ...) do { \
-	if (!(condition)) { printf(__VA_ARGS__); } \
-assert ((condition)); } while(false)
+bool debugging                      = false;
+bool classifyMisses                 = false;
+bool writeAllocate                  = true;
 
-static bool debugging               = false;
 static bool insertInCacheHitProfile = false;
+static bool trackFootprint          = false;
+static size_t footprintExactLimit   = 0;
+static bool simulateTlb             = false;
+static bool simulateDram            = false;
+static CacheSimulator::DramConfig     dramConfig;
+static CacheSimulator::TimingEstimate timingEstimate;
+static bool studyLineSizes          = false;
+static bool selfProfile             = false;
+static CacheSimulator::TlbConfig   tlbConfig;
+static CacheSimulator::PageSizeMap tlbPageSizes;
 
 namespace CacheSimulator {
 
-  static const size_t cacheLineSizeLog2 = 6;
-  static const size_t cacheLineSize     = 1 << cacheLineSizeLog2;
-
-  class CacheHitCounter {
-
-    static const size_t  depthLog2 = 4;
-    static const size_t  depth     = 1 << depthLog2;
-    size_t  widthLog2;
-    size_t  width;
-    size_t  widthMask;
-    size_t  hits;
-    size_t  misses;
-    size_t  addressesLen;
-    size_t* addresses;
-    size_t  maxSize;
-
-    CacheHitCounter & operator =(CacheHitCounter const & CacheHitProfile1);
-    CacheHitCounter(CacheHitCounter const &);
-
-  public:
-    CacheHitCounter() {}
-    CacheHitCounter(size_t maxSizeLog2) {
-      maxSize         = size_t(1)<<maxSizeLog2;
-      widthLog2       = maxSizeLog2 - cacheLineSizeLog2 - depthLog2;
-      width           = size_t(1)<<widthLog2;
-      widthMask       = width-1;
-      addresses       = new size_t[addressesLen];
-
-      clear();
-    }
-
-    void initialize(size_t size) {
-      maxSize         = size;
-      width           = size / ((1<<depthLog2) * cacheLineSize);
-      widthMask       = width-1;
-      addressesLen    = depth*width;
-
-      addresses	      = new size_t[addressesLen];
-
-      clear();
-    }
-
-    void clear() {
-      hits   = 0;
-      misses = 0;
-      for (size_t i = 0; i < addressesLen; i++) addresses[i] = 0;
-    }
-
-    void clearAddresses() 
-    {
-      memset(addresses, 0, addressesLen * sizeof(size_t));
-    }
-
-    ~CacheHitCounter() {
-      delete [] addresses;
-    }
-
-    void insert(size_t cacheLine, size_t hashedCacheLine) {
-
-      size_t col = hashedCacheLine % width; 
-      size_t* c  = &addresses[col*depth];
-      size_t  pc = cacheLine;
-      size_t  r  = 0;
-      for (; r < depth; r++) {
-	size_t oldC = c[r];
-	c[r] = pc;
-	if (oldC == cacheLine) {
-	  hits++;
-	  return;
-	}
-	pc = oldC;
-      }
-      misses++;
-    };
-
-    size_t getHits() {
-      return hits;
-    }
-
-    double getHitRatio() {
-      size_t total = hits + misses;
-
-      return (double)hits / total;
-    }
-
-    double getMissRatio() {
-      size_t total = hits + misses;
-
-      return (double)misses / total;
-    }
-
-    size_t getTotalAccesses() { return hits + misses; }
-
-    size_t getCacheSize()     { return maxSize / MB(1); }
-
-    void PrintConfig() {
-      printf("CacheSize %lu, width %lu, addressesLen %lu\n", maxSize / MB(1), width, addressesLen);
-    }
-  };
-
-  class CacheHitProfile {
-    // 1M, 2M, 4M, 6M, 8M, 10M, 12M, 14M, 16M
-    static const size_t numberOfCacheConfigs = 1;
-    CacheHitCounter	_hitCounter[numberOfCacheConfigs];
-		
-  public:
-    CacheHitProfile()
-    {
-      // 1M, 2M, 4M, 6M, 8M, 10M, 12M, 14M, 16M
-      size_t cacheSize = MB(8);
-      _hitCounter[0].initialize(cacheSize);
-      cacheSize = MB(2);
-      //#pragma omp parallel for shared(cacheSize)
-      for (size_t configIdx = 1; configIdx < numberOfCacheConfigs; configIdx++) {
-	_hitCounter[configIdx].initialize(cacheSize);
-	cacheSize += MB(2);
-      }
-    }
-
-    void PrintGranularity(std::ostream & os) {
-      for (size_t configIdx = 0; configIdx < numberOfCacheConfigs; configIdx++) {
-	os << ", " << _hitCounter[configIdx].getCacheSize();
-      }
-    }
-
-    void clear() {
-      for (size_t configIdx = 0; configIdx < numberOfCacheConfigs; configIdx++) 
-	_hitCounter[configIdx].clear();
-    }
-
-    void clearAddresses() {
-      for (size_t configIdx = 0; configIdx < numberOfCacheConfigs; configIdx++) 
-	_hitCounter[configIdx].clearAddresses();
-    }
-
-    void insert(size_t cacheLine) {
-      size_t hashedCacheLine = cacheLine ^ (cacheLine>>13);
-			  
-      for (size_t configIdx = 0; configIdx < numberOfCacheConfigs; configIdx++) 
-	_hitCounter[configIdx].insert(cacheLine, hashedCacheLine);
-    }
-
-    void PrintConfigs() {
-      for (size_t configIdx = 0; configIdx < numberOfCacheConfigs; configIdx++)
-	_hitCounter[configIdx].PrintConfig();
-    }
-
-    void printHitRatios(std::ostream &os, std::string& name) {
-      os << name;
-      for (size_t configIdx = 0; configIdx < numberOfCacheConfigs; configIdx++)
-	os << "," << _hitCounter[configIdx].getHitRatio();
-      os << ", " << _hitCounter[0].getTotalAccesses() << std::endl;
-    }
-  };
-
   class AnnotatedSites {
 
     class Site {
@@ -180,32 +42,125 @@ namespace CacheSimulator {
       Site();
 
       CacheHitProfile 	*currentCHiP;
+      CacheHitProfile	*baseCHiP;	// checkpointed cache state, NULL if cold
+      Footprint		*footprint;	// NULL unless footprints are tracked
+      TlbModel		*tlb;		// NULL unless TLBs are simulated
+      DramModel		*dram;		// NULL unless DRAM is simulated
+      LineSizeStudy	*lineStudy;	// NULL unless line sizes are studied
       uint32_t		executionCount;
+      std::vector<size_t> executionInstructions;	// per thread id, current execution
 
     public:
+      size_t		instructions;
+      size_t		threadInstructions;	// busiest thread of every execution, summed
       std::string	siteName;
+      bool		warm;		// keep cache contents across executions
 
-      Site(char *name) : executionCount(0)
+      Site(char *name, bool warm, CacheHitProfile *base) : baseCHiP(base), footprint(NULL), tlb(NULL), dram(NULL), lineStudy(NULL),
+								      executionCount(0), instructions(0),
+								      threadInstructions(0), warm(warm)
       {
 	currentCHiP  = new CacheHitProfile;
+	if (trackFootprint)
+	  footprint  = new Footprint(footprintExactLimit);
+	if (simulateTlb)
+	  tlb        = new TlbModel(tlbConfig, tlbPageSizes);
+	if (simulateDram) {
+	  dram       = new DramModel(dramConfig);
+	  currentCHiP->attachMemory(dram);
+	}
+	if (studyLineSizes)
+	  lineStudy  = new LineSizeStudy(currentCHiP->getCacheBytes());
 	siteName.assign(name);
+	ResetChipAddresses();
       }
 
       ~Site()
       {
 	delete currentCHiP;
+	delete baseCHiP;
+	delete footprint;
+	delete tlb;
+	delete dram;
+	delete lineStudy;
       }
 
-      void insert(uint64_t address) {
-	currentCHiP->insert(address);
+      // entry is a buffered access, see packAccess()
+      void insert(uint64_t entry) {
+	size_t     addr = accessAddress(entry);
+	size_t     size = accessSize(entry);
+	AccessType type = accessType(entry);
+
+	size_t lo = addr            >> cacheLineSizeLog2;
+	size_t hi = (addr + size - 1) >> cacheLineSizeLog2;
+	for (size_t cacheLine = lo; cacheLine <= hi; cacheLine++) {
+	  size_t first = (cacheLine == lo) ? addr & (cacheLineSize - 1) : 0;
+	  size_t last  = (cacheLine == hi) ? (addr + size - 1) & (cacheLineSize - 1) : cacheLineSize - 1;
+	  currentCHiP->insert(cacheLine, type, first, last - first + 1);
+	  if (footprint) footprint->insert(cacheLine, type & Write);
+	  if (tlb)       tlb->insert(cacheLine);
+	}
+	if (lineStudy) lineStudy->insert(addr, size);
+      }
+
+      // called when an execution of the site stops, and at exit
+      void finishExecution() {
+	currentCHiP->flushWrites();
+	if (!executionInstructions.empty())
+	  threadInstructions += *std::max_element(executionInstructions.begin(), executionInstructions.end());
+	executionInstructions.clear();
+      }
+
+      void addInstructions(size_t threadId, size_t count) {
+	instructions += count;
+	if (threadId >= executionInstructions.size())
+	  executionInstructions.resize(threadId + 1, 0);
+	executionInstructions[threadId] += count;
       }
 
       void PrintStats(std::ostream &os) {
 	currentCHiP->printHitRatios(os, siteName);
       }
 
-      void ClearChipAddresses() {
-	currentCHiP->clearAddresses();
+      void PrintTraffic(std::ostream &os) {
+	currentCHiP->printTraffic(os, siteName);
+      }
+
+      void PrintMissClasses(std::ostream &os) {
+	currentCHiP->printMissClasses(os, siteName);
+      }
+
+      void PrintFootprint(std::ostream &os, std::ostream &growthOs) {
+	if (!footprint) return;
+	footprint->PrintStats(os, siteName);
+	footprint->PrintGrowth(growthOs, siteName);
+      }
+
+      void PrintTlb(std::ostream &os) {
+	if (tlb) tlb->PrintStats(os, siteName);
+      }
+
+      void PrintLineSizes(std::ostream &os) {
+	if (lineStudy) lineStudy->PrintStats(os, siteName);
+      }
+
+      void PrintDram(std::ostream &os) {
+	if (dram) dram->PrintStats(os, siteName, instructions, threadInstructions, timingEstimate);
+      }
+
+      // restore the cache to its state at the start of the run
+      void ResetChipAddresses() {
+	if (baseCHiP)
+	  currentCHiP->copyAddresses(*baseCHiP);
+	else
+	  currentCHiP->clearAddresses();
+	if (tlb)  tlb->clearEntries();
+	if (dram) dram->clearBanks();
+	if (lineStudy) lineStudy->clearLines();
+      }
+
+      bool SaveChip(FILE *fp) {
+	return currentCHiP->save(fp);
       }
 
       void PrintGranularity(std::ostream& os) {
@@ -222,38 +177,165 @@ namespace CacheSimulator {
     };
 
     bool			siteActive;
+    bool			allSitesWarm;
+    double			siteStartSeconds;
+    double			siteSeconds;	// wall time inside sites
 
     Site			*currentSite;
 
     std::set<Site*> sitesHashSet;
+    std::set<std::string> warmSiteNames;
+    std::map<std::string, CacheHitProfile*> checkpointedCHiPs;
+
+    static const char checkpointMagic[8];
+    // longer names in a checkpoint mean it is corrupt
+    static const uint32_t maxSiteNameLen = 4096;
+
   public:
     AnnotatedSites() 
     {
       siteActive      = false;
+      allSitesWarm    = false;
       currentSite     = NULL;
+      siteStartSeconds = siteSeconds = 0;
     }
 
     ~AnnotatedSites() 
     {
     }
 
-    void recordMemoryAccess(size_t addr)
+    // names is a comma separated list of sites whose cache state is kept
+    // across executions, or "all". Every other site starts each execution
+    // from the checkpointed state, or cold if there is none.
+    void SetWarmSites(const std::string &names)
+    {
+      size_t begin = 0;
+      while (begin <= names.size()) {
+	size_t end = names.find(',', begin);
+	if (end == std::string::npos) end = names.size();
+
+	std::string name = names.substr(begin, end - begin);
+	if (name == "all")
+	  allSitesWarm = true;
+	else if (!name.empty())
+	  warmSiteNames.insert(name);
+
+	begin = end + 1;
+      }
+    }
+
+    bool LoadCheckpoint(const char *fileName)
+    {
+      FILE *fp = fopen(fileName, "rb");
+      if (fp == NULL) {
+	std::cerr << "Error: cannot open checkpoint " << fileName << std::endl;
+	return false;
+      }
+
+      char     magic[sizeof(checkpointMagic)];
+      uint32_t numSites = 0;
+      bool     ok = fread(magic, sizeof(magic), 1, fp) == 1 &&
+	memcmp(magic, checkpointMagic, sizeof(magic)) == 0 &&
+	fread(&numSites, sizeof(numSites), 1, fp) == 1;
+
+      for (uint32_t i = 0; ok && i < numSites; i++) {
+	uint32_t nameLen;
+	ok = fread(&nameLen, sizeof(nameLen), 1, fp) == 1 && nameLen <= maxSiteNameLen;
+	if (!ok) break;
+
+	std::string name(nameLen, '\0');
+	ok = fread(&name[0], 1, nameLen, fp) == nameLen;
+	if (!ok) break;
+
+	CacheHitProfile *chip = new CacheHitProfile(false);
+	ok = chip->load(fp);
+	if (!ok) { delete chip; break; }
+
+	delete checkpointedCHiPs[name];
+	checkpointedCHiPs[name] = chip;
+      }
+      fclose(fp);
+
+      if (!ok)
+	std::cerr << "Error: checkpoint " << fileName << " is corrupt or incompatible" << std::endl;
+      else
+	std::cout << "Loaded cache state of " << numSites << " sites from " << fileName << std::endl;
+      return ok;
+    }
+
+    bool SaveCheckpoint(const char *fileName)
+    {
+      FILE *fp = fopen(fileName, "wb");
+      if (fp == NULL) {
+	std::cerr << "Error: cannot create checkpoint " << fileName << std::endl;
+	return false;
+      }
+
+      // sites loaded from a previous checkpoint but not executed in this
+      // run are carried over unchanged
+      uint32_t numSites = sitesHashSet.size() + checkpointedCHiPs.size();
+      bool     ok = fwrite(checkpointMagic, sizeof(checkpointMagic), 1, fp) == 1 &&
+	fwrite(&numSites, sizeof(numSites), 1, fp) == 1;
+
+      for (auto it = sitesHashSet.begin(); ok && it != sitesHashSet.end(); it++) {
+	uint32_t nameLen = (*it)->siteName.size();
+	ok = nameLen <= maxSiteNameLen && fwrite(&nameLen, sizeof(nameLen), 1, fp) == 1 &&
+	  fwrite((*it)->siteName.data(), 1, nameLen, fp) == nameLen &&
+	  (*it)->SaveChip(fp);
+      }
+      for (auto it = checkpointedCHiPs.begin(); ok && it != checkpointedCHiPs.end(); it++) {
+	uint32_t nameLen = it->first.size();
+	ok = nameLen <= maxSiteNameLen && fwrite(&nameLen, sizeof(nameLen), 1, fp) == 1 &&
+	  fwrite(it->first.data(), 1, nameLen, fp) == nameLen &&
+	  it->second->save(fp);
+      }
+      ok = (fclose(fp) == 0) && ok;
+
+      if (!ok)
+	std::cerr << "Error: failed to write checkpoint " << fileName << std::endl;
+      return ok;
+    }
+
+    void recordMemoryAccess(size_t entry)
+    {
+      currentSite->insert(entry);
+    }
+
+    void recordInstructions(size_t threadId, size_t count)
     {
-      currentSite->insert(addr);
+      if (currentSite) currentSite->addInstructions(threadId, count);
     }
 
     void StartCollection(char* name, void* siteObj)
     {
       siteActive  = true;
+      siteStartSeconds = wallSeconds();
       SiteObjPtr *sitePtr = (SiteObjPtr *)siteObj;
       currentSite = sitePtr->site;
 
       if (currentSite == NULL) {
 	std::cout << "Site found : " << name << std::endl;
-	currentSite		= new Site(name);
+
+	bool warm = allSitesWarm || warmSiteNames.count(name);
+	CacheHitProfile *base = NULL;
+	auto checkpointed = checkpointedCHiPs.find(name);
+	if (checkpointed != checkpointedCHiPs.end()) {
+	  base = checkpointed->second;
+	  checkpointedCHiPs.erase(checkpointed);
+	}
+
+	currentSite		= new Site(name, warm, base);
 	sitePtr->site	= currentSite;
 	sitesHashSet.insert(currentSite);
       }
+      else if (!currentSite->warm)
+	currentSite->ResetChipAddresses();
+    }
+
+    // siteObj NULL asks whether any site is active
+    bool IsActive(void* siteObj)
+    {
+      return siteActive && (siteObj == NULL || currentSite == ((SiteObjPtr *)siteObj)->site);
     }
 
     void StopCollection(void* siteObj)
@@ -265,8 +347,9 @@ namespace CacheSimulator {
 	exit(-1);
       }
 
+      currentSite->finishExecution();
       siteActive = false;
-      currentSite->ClearChipAddresses();
+      siteSeconds += wallSeconds() - siteStartSeconds;
     }
 
     void PrintStats(std::ostream & os)
@@ -278,7 +361,74 @@ namespace CacheSimulator {
       for (auto it = sitesHashSet.begin(); it != sitesHashSet.end(); it++)
 	(*it)->PrintStats(os);
     }
+
+    // a site still active at exit has not finished its execution
+    void FinishSites()
+    {
+      if (!siteActive) return;
+      currentSite->finishExecution();
+      siteActive   = false;
+      siteSeconds += wallSeconds() - siteStartSeconds;
+    }
+
+    void PrintTraffic(std::ostream & os)
+    {
+      os << "region, size, fillBytes, writebackBytes, writeThroughBytes, nonTemporalBytes" << std::endl;
+      for (auto it = sitesHashSet.begin(); it != sitesHashSet.end(); it++)
+	(*it)->PrintTraffic(os);
+    }
+
+    void PrintMissClasses(std::ostream & os)
+    {
+      os << "region, size, compulsory, capacity, conflict" << std::endl;
+      for (auto it = sitesHashSet.begin(); it != sitesHashSet.end(); it++)
+	(*it)->PrintMissClasses(os);
+    }
+
+    void PrintFootprints(std::ostream & os, std::ostream & growthOs)
+    {
+      os << "region, lines, pages4K, pages2M, readLines, writeLines, method" << std::endl;
+      growthOs << "region, accesses, lines" << std::endl;
+      for (auto it = sitesHashSet.begin(); it != sitesHashSet.end(); it++)
+	(*it)->PrintFootprint(os, growthOs);
+    }
+
+    void PrintLineSizes(std::ostream & os)
+    {
+      os << "region, lineSize, sectorSize, accesses, misses, sectorMisses, fetchedBytes, utilization, "
+	"util0-12%, util12-25%, util25-37%, util37-50%, util50-62%, util62-75%, util75-87%, util87-100%" << std::endl;
+      for (auto it = sitesHashSet.begin(); it != sitesHashSet.end(); it++)
+	(*it)->PrintLineSizes(os);
+    }
+
+    void PrintDram(std::ostream & os)
+    {
+      os << "region, instructions, threadInstructions, reads, writes, rowHitRate, rowEmpty, bankConflicts, "
+	"bytesPerKiloInst, GBps, peakFraction" << std::endl;
+      for (auto it = sitesHashSet.begin(); it != sitesHashSet.end(); it++)
+	(*it)->PrintDram(os);
+    }
+
+    // instructions of the busiest thread of every site execution
+    size_t ThreadInstructions()
+    {
+      size_t total = 0;
+      for (auto it = sitesHashSet.begin(); it != sitesHashSet.end(); it++)
+	total += (*it)->threadInstructions;
+      return total;
+    }
+
+    double SiteSeconds() { return siteSeconds; }
+
+    void PrintTlb(std::ostream & os)
+    {
+      os << "region, pages, accesses, l1Misses, stlbMisses, walkRefs" << std::endl;
+      for (auto it = sitesHashSet.begin(); it != sitesHashSet.end(); it++)
+	(*it)->PrintTlb(os);
+    }
   };
+
+  const char AnnotatedSites::checkpointMagic[8] = { 'P', 'C', 'S', 'C', 'K', 'P', 'T', '2' };
 };	// namespace
 
 KNOB<bool> KNOB_RECORD_ALL (KNOB_MODE_WRITEONCE, "pintool",
@@ -291,70 +441,84 @@ KNOB<string> KNOB_DETAILED_TASK_REPORT (KNOB_MODE_WRITEONCE, "pintool",
 					"detailedTaskReport", "detailedTaskReport.csv" ,"detailed report file name");
 KNOB<string> KNOB_TASK_REPORT (KNOB_MODE_WRITEONCE, "pintool",
 			       "taskReport", "taskReport.csv" ,"report file name");
+KNOB<string> KNOB_WARM_SITES (KNOB_MODE_WRITEONCE, "pintool",
+			      "warmSites", "", "comma separated sites that keep cache state across executions, or all");
+KNOB<string> KNOB_CHECKPOINT_IN (KNOB_MODE_WRITEONCE, "pintool",
+				 "checkpointIn", "", "cache checkpoint to warm-start sites from");
+KNOB<string> KNOB_CHECKPOINT_OUT (KNOB_MODE_WRITEONCE, "pintool",
+				  "checkpointOut", "", "file to save the cache state of all sites to at exit");
+KNOB<bool> KNOB_CLASSIFY_MISSES (KNOB_MODE_WRITEONCE, "pintool",
+				 "classifyMisses", "0", "split misses into compulsory, capacity and conflict");
+KNOB<string> KNOB_MISS_CLASS_REPORT (KNOB_MODE_WRITEONCE, "pintool",
+				     "missClassReport", "missClassReport.csv", "miss classification report file name");
+KNOB<bool> KNOB_FOOTPRINT (KNOB_MODE_WRITEONCE, "pintool",
+			   "footprint", "0", "track distinct lines and pages touched per site");
+KNOB<UINT32> KNOB_FOOTPRINT_EXACT_MB (KNOB_MODE_WRITEONCE, "pintool",
+				      "footprintExactMB", "64", "memory for exact line sets per site before switching to estimates");
+KNOB<string> KNOB_FOOTPRINT_REPORT (KNOB_MODE_WRITEONCE, "pintool",
+				    "footprintReport", "footprintReport.csv", "footprint report file name");
+KNOB<string> KNOB_FOOTPRINT_GROWTH_REPORT (KNOB_MODE_WRITEONCE, "pintool",
+					   "footprintGrowthReport", "footprintGrowth.csv", "footprint growth report file name");
+KNOB<bool> KNOB_TLB (KNOB_MODE_WRITEONCE, "pintool",
+		     "tlb", "0", "simulate dTLBs and page walks per site");
+KNOB<string> KNOB_TLB_CONFIG (KNOB_MODE_WRITEONCE, "pintool",
+			      "tlbConfig", "", "TLB geometry, e.g. l1_4k=64x4,l1_2m=32x4,l1_1g=4x4,stlb=1536x12,stlb_1g=16x4,pwc=32x4");
+KNOB<string> KNOB_TLB_PAGE_REGIONS (KNOB_MODE_WRITEONCE, "pintool",
+				    "tlbPageRegions", "", "page size per address region, e.g. 0x7f0000000000-0x7fffffffffff:2M");
+KNOB<string> KNOB_TLB_REPORT (KNOB_MODE_WRITEONCE, "pintool",
+			      "tlbReport", "tlbReport.csv", "TLB report file name");
+KNOB<bool> KNOB_QSIM_MAGIC (KNOB_MODE_WRITEONCE, "pintool",
+			    "qsimMagic", "1", "start and stop a site at the qsim magic cpuid instructions");
+KNOB<bool> KNOB_WRITE_ALLOCATE (KNOB_MODE_WRITEONCE, "pintool",
+				"writeAllocate", "1", "allocate lines on write misses");
+KNOB<string> KNOB_NON_TEMPORAL (KNOB_MODE_WRITEONCE, "pintool",
+				"nonTemporal", "detect", "streaming stores: detect, ignore, or all to treat every store as one");
+KNOB<string> KNOB_TRAFFIC_REPORT (KNOB_MODE_WRITEONCE, "pintool",
+				  "trafficReport", "trafficReport.csv", "memory traffic report file name");
+KNOB<bool> KNOB_DRAM (KNOB_MODE_WRITEONCE, "pintool",
+		      "dram", "0", "simulate DRAM row buffers and bandwidth behind the cache");
+KNOB<string> KNOB_DRAM_CONFIG (KNOB_MODE_WRITEONCE, "pintool",
+			       "dramConfig", "", "DRAM organisation, e.g. channels=2,ranks=2,banks=16,rowBytes=8192,mtps=3200,xor=1,map=co:ch:ba:ra:ro");
+KNOB<string> KNOB_TIMING_ESTIMATE (KNOB_MODE_WRITEONCE, "pintool",
+				   "timingEstimate", "", "native speed used for rates, e.g. ipc=1.0,ghz=3.0");
+KNOB<string> KNOB_DRAM_REPORT (KNOB_MODE_WRITEONCE, "pintool",
+			       "dramReport", "dramReport.csv", "DRAM report file name");
+KNOB<bool> KNOB_LINE_SIZE_STUDY (KNOB_MODE_WRITEONCE, "pintool",
+				 "lineSizes", "0", "simulate 32 to 256 B lines and sectored caches and report line utilization");
+KNOB<string> KNOB_LINE_SIZE_REPORT (KNOB_MODE_WRITEONCE, "pintool",
+				    "lineSizeReport", "lineSizeReport.csv", "line size report file name");
+KNOB<string> KNOB_TRACE_FILE (KNOB_MODE_WRITEONCE, "pintool",
+			      "traceFile", "", "capture the simulated accesses of all sites for sweep_cachesim");
+KNOB<bool> KNOB_SELF_PROFILE (KNOB_MODE_WRITEONCE, "pintool",
+			      "selfProfile", "0", "time instrumentation and analysis calls, and count instructions");
+KNOB<string> KNOB_OVERHEAD_REPORT (KNOB_MODE_WRITEONCE, "pintool",
+				   "overheadReport", "overheadReport.csv", "tool overhead report file name");
+KNOB<UINT32> KNOB_MAX_THREADS (KNOB_MODE_WRITEONCE, "pintool",
+			       "maxThreads", "1024", "maximum number of live application threads");
+KNOB<UINT32> KNOB_THREAD_BUFFER_KB (KNOB_MODE_WRITEONCE, "pintool",
+				    "threadBufferKB", "1024", "per-thread address buffer size in KB");
+KNOB<bool> KNOB_HUGE_PAGE_BUFFERS (KNOB_MODE_WRITEONCE, "pintool",
+				   "hugePageBuffers", "0", "back address buffers with transparent huge pages");
 std::ofstream siteReportFile;
 std::ofstream detailedSiteReportFile;
 std::ofstream taskReportFile;
 std::ofstream detailedTaskReportFile;
 std::ofstream traceInFile;
 std::ofstream traceOutFile;
-
-size_t noted(0);
-size_t inserted(0);
-size_t considered(0);
-size_t instrumented(0);
-size_t numThreads(0);
-
-static const  size_t maxThreads        = 4;
-static size_t cacheLineSizeLog2        = 6;
+static FILE  *traceFile = NULL;		// binary capture for sweep_cachesim
 
 CacheSimulator::AnnotatedSites annotatedSites;
 
-PIN_LOCK lock, simlock;
+PIN_LOCK simlock;
 static TLS_KEY tlsKey;
 
-class PerThreadAddressStore {
-  size_t *addresses;
-  size_t  count;
-  size_t  max_count;
-  size_t  top;
-public:
-  PerThreadAddressStore() : count(0), top(0) {
-    max_count = MB(1) / sizeof(size_t);
-    addresses = new size_t[max_count];
-  }
-
-  ~PerThreadAddressStore() {
-    if (debugging) printf("deleting address store\n");
-    delete [] addresses;
-  }
-
-  // stores address for the thread and returns if buffer is full
-  bool StoreAddress(char* addr, size_t size, int threadId) {
-    size_t lo = size_t(addr       ) >> cacheLineSizeLog2;
-    size_t hi = size_t(addr+size-1) >> cacheLineSizeLog2;
-
-    for (size_t cacheLine = lo; cacheLine <= hi; cacheLine++) {
-      ASSERTM(cacheLine != 0, "cacheline is 0 while inserting\n");
-      addresses[count++] = cacheLine;
-      traceInFile << hex << cacheLine << std::endl;
-    }
-
-    // keep a padding of 64 entries to report buffer filled
-    if (count + 64 >= max_count)
-      return true;
-
-    return false;
-  }
-
-  size_t getAddress() {
-    //if (debugging) printf("current store top: %d, count: %d, max_count: %d\n", top, count, max_count);
-    if (top < count)
-      return addresses[top++];
+static ThreadBufferRegistry threadBuffers;
 
-    top = 0; count = 0;
-    return 0;
-  }
-};
+// counters of threads that have exited, and of instrumentation done
+// outside an application thread; both only change under the client lock
+static CacheSimulator::ThreadCounters retiredCounters;
+static CacheSimulator::ThreadCounters toolCounters;
+static CacheSimulator::OverheadReport overheadReport;
 
 static PerThreadAddressStore* getThreadData(THREADID tid)
 {
@@ -365,97 +529,78 @@ static PerThreadAddressStore* getThreadData(THREADID tid)
   return addressStore;
 }
 
-static void printAndClearStats() {
-  if (debugging) printf("noted %.0f, inserted %0.f, considered %.0f, instrumented %.0f\n", float(noted), float(inserted), float(considered), float(instrumented));
-  noted = 0;
-  inserted = 0;
-  considered = 0;
-  instrumented = 0;
+static CacheSimulator::ThreadCounters& getCounters(THREADID tid)
+{
+  PerThreadAddressStore *addressStore = (tid == INVALID_THREADID) ? NULL : getThreadData(tid);
+  return addressStore ? addressStore->counters : toolCounters;
 }
 
-class AddressStore {
-  PerThreadAddressStore **stores;
-
-  bool   *storeExhausted;
-  size_t numStoresExhausted;
-  size_t numStores;
-  size_t currentIdx;
-  AddressStore();
-
-public:
-  AddressStore(size_t numThreads) {
-
-    if (debugging) printf("creating address store for %lu threads\n", numThreads);
-    numStores			= numThreads;
-    stores				= new PerThreadAddressStore*[numThreads];
-    storeExhausted		= new bool[numThreads];
-
-    for (size_t i = 0; i < numThreads; i++) {
-      stores[i]         =  getThreadData(i);
-      storeExhausted[i] =  false;
-    }
-
-    numStoresExhausted	= 0;
-    currentIdx			= 0;
-  }
-
-  ~AddressStore() {
-    delete [] stores;
-    delete [] storeExhausted;
-  }
-
-  void incrementIndex() {
-    currentIdx++;
-    if (currentIdx == numStores) 
-      currentIdx = 0;
+// Counters of all threads so far. Live threads count their lifetime up to
+// now; work done outside application threads counts as its own thread.
+static CacheSimulator::ThreadCounters totalCounters()
+{
+  CacheSimulator::ThreadCounters total, tool(toolCounters);
+  tool.count[CacheSimulator::ThreadTicks] = tool.phaseTicks();
+  total.add(retiredCounters);
+  total.add(tool);
+  for (size_t i = 0; i < threadBuffers.size(); i++) {
+    CacheSimulator::ThreadCounters live(threadBuffers[i]->counters);
+    live.stopClock();
+    total.add(live);
   }
+  return total;
+}
 
+static void printStats() {
+  CacheSimulator::ThreadCounters total = totalCounters();
+  printf("noted %.0f, inserted %0.f, considered %.0f, instrumented %.0f\n",
+	 float(total.count[CacheSimulator::Noted]), float(total.count[CacheSimulator::Inserted]),
+	 float(total.count[CacheSimulator::Considered]), float(total.count[CacheSimulator::Instrumented]));
+}
 
-  // return false if all the addresses have been exhausted
-  bool getNextAddress(size_t *addr) {
-		
-    while(numStoresExhausted < numStores) {
-
-      if (storeExhausted[currentIdx] == false) {
-	*addr = (size_t)stores[currentIdx]->getAddress();
-				
-	// current store has exhausted
-	// move to next store
-	if (*addr == 0) { 
-	  if (debugging) printf("store with idx %lu exhausted...\n", currentIdx);
-	  storeExhausted[currentIdx] = true;
-	  numStoresExhausted++;
-
-	  incrementIndex();
-	  continue;
-	}
-
-	return true;
-      }
-      else
-	incrementIndex();
-    }
-
-    return false;
-  }
-};
+// entries are pulled out of the thread buffers in batches, so that
+// draining and simulating can be timed separately
+static const size_t drainBatchSize = 4096;
 
 static VOID SimulateAddresses()
 {
+  using namespace CacheSimulator;
+  ThreadCounters &counters = getCounters(PIN_ThreadId());
+
+  uint64_t waitStart = readTicks();
   PIN_LockClient();
-  AddressStore addressStore(numThreads);
+  counters.count[LockWaitTicks] += readTicks() - waitStart;
+  counters.count[Drains]++;
+
+  AddressStore addressStore(threadBuffers);
+
+  static size_t batch[drainBatchSize];
+  bool more = true;
+  while (more) {
+    uint64_t drainStart = readTicks();
+    size_t   n = 0;
+    while (n < drainBatchSize && (more = addressStore.getNextAddress(&batch[n])) != false) {
+      ASSERTM(batch[n] != 0, "BUG: addr is 0\n");
+      n++;
+    }
 
-  size_t addr = 0;
-  bool ret;
-  while((ret = addressStore.getNextAddress(&addr)) != false) {
-    if (addr == 0) {
-      ASSERTM(addr != 0, "BUG: addr is 0. ret %d\n", ret);
+    uint64_t simulateStart = readTicks();
+    if (traceFile && fwrite(batch, sizeof(size_t), n, traceFile) != n) {
+      std::cerr << "Error: failed to write the trace file" << std::endl;
+      exit(-1);
+    }
+    for (size_t i = 0; i < n; i++) {
+      traceOutFile << hex << batch[i] << std::endl;
+      annotatedSites.recordMemoryAccess(batch[i]);
     }
-		
-    traceOutFile << hex << addr << std::endl;
-    annotatedSites.recordMemoryAccess(addr);
+
+    counters.count[DrainTicks]    += simulateStart - drainStart;
+    counters.count[SimulateTicks] += readTicks() - simulateStart;
   }
 
+  for (size_t i = 0; i < threadBuffers.size(); i++)
+    annotatedSites.recordInstructions(threadBuffers[i]->threadId, threadBuffers[i]->takeInstructions());
+
   PIN_UnlockClient();
 }
 
@@ -469,27 +614,44 @@ void changeInsertInCacheHitProfile(bool to) {
 }
 
 // ref: http://tech.groups.yahoo.com/group/pinheads/message/3574
-static VOID PIN_FAST_ANALYSIS_CALL noteMemoryAccess(CHAR * addr, UINT32 size, UINT32 threadId)
+static VOID PIN_FAST_ANALYSIS_CALL noteMemoryAccess(CHAR * addr, UINT32 size, UINT32 type, UINT32 threadId)
 {
-  noted++;
+  using namespace CacheSimulator;
+  uint64_t start = selfProfile ? readTicks() : 0;
+
+  auto addressStore = getThreadData(threadId);
+  if (addressStore == NULL) {
+    fprintf(stderr, "getThreadData returned 0 for tid %d\n", threadId);
+    assert(0);
+  }
+
+  ThreadCounters &counters = addressStore->counters;
+  counters.count[Noted]++;
   if (insertInCacheHitProfile && (size > 0)) {
-    inserted++;
-    auto addressStore = getThreadData(threadId);
-    if (addressStore == NULL) {
-      fprintf(stderr, "getThreadData returned 0 for tid %d\n", threadId);
-      assert(0);
-    }
+    counters.count[Inserted]++;
+
+    traceInFile << hex << packAccess(size_t(addr), size, type) << std::endl;
 
     // buffer full
-    if (addressStore->StoreAddress(addr, size, threadId) == true) {
+    if (addressStore->StoreAddress(addr, size, type, threadId) == true) {
       if (debugging) {
 	printf("buffer is full, simulating...\n");
 	traceInFile  << "buffer is full, simulating...\n" << std::endl;
 	traceOutFile << "buffer is full, simulating...\n" << std::endl;
       }
+      counters.count[BufferFlushes]++;
+      if (selfProfile) counters.count[AnalysisTicks] += readTicks() - start;
       SimulateAddresses();
+      return;
     }
   }
+  if (selfProfile) counters.count[AnalysisTicks] += readTicks() - start;
+}
+
+static VOID PIN_FAST_ANALYSIS_CALL noteInstructions(UINT32 count, UINT32 threadId)
+{
+  if (insertInCacheHitProfile)
+    getThreadData(threadId)->addInstructions(count);
 }
 
 VOID PIN_FAST_ANALYSIS_CALL startCacheHitProfiling(char *name, void* siteObj)
@@ -511,6 +673,33 @@ VOID PIN_FAST_ANALYSIS_CALL stopCacheHitProfiling(void* siteObj)
   annotatedSites.StopCollection(siteObj);
 }
 
+// qsim_magic.h marks the region of interest with cpuid and these values
+// in eax instead of calling the annotation functions. The region becomes
+// a site of its own, whose object lives in the tool.
+static const UINT32 qsimMagicEnable  = 0xaaaaaaaa;
+static const UINT32 qsimMagicDisable = 0xfa11dead;
+static bool  detectQsimMagic = true;
+static char  qsimSiteName[]  = "qsim_roi";
+static void *qsimSiteObj     = NULL;
+
+// Sites do not nest: the magic values are ignored while an annotated site
+// is active, and the disable value only stops the qsim site itself.
+static VOID noteCpuid(ADDRINT eax)
+{
+  static bool warned = false;
+
+  if (UINT32(eax) == qsimMagicEnable) {
+    if (!annotatedSites.IsActive(NULL))
+      startCacheHitProfiling(qsimSiteName, &qsimSiteObj);
+    else if (!warned) {
+      std::cerr << "Warning: qsim region start inside an active site ignored" << std::endl;
+      warned = true;
+    }
+  }
+  else if (UINT32(eax) == qsimMagicDisable && qsimSiteObj && annotatedSites.IsActive(&qsimSiteObj))
+    stopCacheHitProfiling(&qsimSiteObj);
+}
+
 VOID PIN_FAST_ANALYSIS_CALL startTaskCacheHitProfile(void* siteObj)
 { 
   assert(0);
@@ -523,27 +712,78 @@ VOID PIN_FAST_ANALYSIS_CALL stopTaskCacheHitProfile(void* siteObj)
   if (debugging) printf("stopTaskCacheHitProfiling\n");
 }
 
+enum NonTemporalMode { NonTemporalDetect, NonTemporalIgnore, NonTemporalAll };
+static NonTemporalMode nonTemporalMode = NonTemporalDetect;
+
+static bool IsNonTemporalStore(INS ins)
+{
+  switch (INS_Opcode(ins)) {
+  case XED_ICLASS_MOVNTI:
+  case XED_ICLASS_MOVNTQ:
+  case XED_ICLASS_MOVNTDQ:
+  case XED_ICLASS_MOVNTPS:
+  case XED_ICLASS_MOVNTPD:
+  case XED_ICLASS_MOVNTSS:
+  case XED_ICLASS_MOVNTSD:
+  case XED_ICLASS_MASKMOVQ:
+  case XED_ICLASS_MASKMOVDQU:
+  case XED_ICLASS_VMOVNTDQ:
+  case XED_ICLASS_VMOVNTPS:
+  case XED_ICLASS_VMOVNTPD:
+    return true;
+  default:
+    return false;
+  }
+}
+
 // Pin calls this function every time a new instruction is encountered
 VOID Instruction(INS ins, VOID *v)
 {
-  considered++;
+  using namespace CacheSimulator;
+  ThreadCounters &counters = getCounters(PIN_ThreadId());
+  ScopedTicks     timer(counters.count[InstrumentTicks], selfProfile);
+
+  size_t considered = ++counters.count[Considered];
   if (debugging) if (considered == 1) printf("Instruction(...) considered\n");
 
+  // needed outside the sites too, to see the region start
+  if (detectQsimMagic && INS_Opcode(ins) == XED_ICLASS_CPUID)
+    INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)noteCpuid, IARG_REG_VALUE, REG_GAX, IARG_END);
+
   if (!insertInCacheHitProfile) return;
 
-  instrumented++;
+  size_t instrumented = ++counters.count[Instrumented];
   if (debugging) if (instrumented == 1) printf("Instruction(...) instrumented\n");
 
+  UINT32 read  = CacheSimulator::Read;
+  UINT32 write = CacheSimulator::Write;
+  if (nonTemporalMode == NonTemporalAll ||
+      (nonTemporalMode == NonTemporalDetect && IsNonTemporalStore(ins)))
+    write = CacheSimulator::NonTemporalWrite;
+
   for (bool b = INS_IsMemoryRead(ins); b; b = false) {
-    INS_InsertPredicatedCall(ins, IPOINT_BEFORE, (AFUNPTR)noteMemoryAccess, IARG_FAST_ANALYSIS_CALL, IARG_MEMORYREAD_EA,  IARG_MEMORYREAD_SIZE, IARG_THREAD_ID, IARG_END);
+    INS_InsertPredicatedCall(ins, IPOINT_BEFORE, (AFUNPTR)noteMemoryAccess, IARG_FAST_ANALYSIS_CALL, IARG_MEMORYREAD_EA,  IARG_MEMORYREAD_SIZE, IARG_UINT32, read, IARG_THREAD_ID, IARG_END);
     if (!INS_HasMemoryRead2(ins)) break;
-    INS_InsertPredicatedCall(ins, IPOINT_BEFORE, (AFUNPTR)noteMemoryAccess, IARG_FAST_ANALYSIS_CALL, IARG_MEMORYREAD2_EA, IARG_MEMORYREAD_SIZE, IARG_THREAD_ID, IARG_END);
+    INS_InsertPredicatedCall(ins, IPOINT_BEFORE, (AFUNPTR)noteMemoryAccess, IARG_FAST_ANALYSIS_CALL, IARG_MEMORYREAD2_EA, IARG_MEMORYREAD_SIZE, IARG_UINT32, read, IARG_THREAD_ID, IARG_END);
   }
   if (INS_IsMemoryWrite(ins)) {
-    INS_InsertPredicatedCall(ins, IPOINT_BEFORE, (AFUNPTR)noteMemoryAccess, IARG_FAST_ANALYSIS_CALL, IARG_MEMORYWRITE_EA, IARG_MEMORYWRITE_SIZE, IARG_THREAD_ID, IARG_END);
+    INS_InsertPredicatedCall(ins, IPOINT_BEFORE, (AFUNPTR)noteMemoryAccess, IARG_FAST_ANALYSIS_CALL, IARG_MEMORYWRITE_EA, IARG_MEMORYWRITE_SIZE, IARG_UINT32, write, IARG_THREAD_ID, IARG_END);
   }
 }
 
+// instruction counts are only needed to turn DRAM traffic into rates and
+// to estimate the slowdown
+VOID Trace(TRACE trace, VOID *v)
+{
+  if (!insertInCacheHitProfile || !(simulateDram || selfProfile)) return;
+
+  CacheSimulator::ScopedTicks timer(getCounters(PIN_ThreadId()).count[CacheSimulator::InstrumentTicks], selfProfile);
+
+  for (BBL bbl = TRACE_BblHead(trace); BBL_Valid(bbl); bbl = BBL_Next(bbl))
+    BBL_InsertCall(bbl, IPOINT_BEFORE, (AFUNPTR)noteInstructions, IARG_FAST_ANALYSIS_CALL,
+		   IARG_UINT32, BBL_NumIns(bbl), IARG_THREAD_ID, IARG_END);
+}
+
 /* ===================================================================== */
 /* Print Help Message                                                    */
 /* ===================================================================== */
@@ -556,6 +796,8 @@ INT32 Usage()
 
 VOID Image(IMG img, VOID *v)
 {
+  CacheSimulator::ScopedTicks timer(getCounters(PIN_ThreadId()).count[CacheSimulator::InstrumentTicks], selfProfile);
+
   string startSiteName("ANNOTATE_SITE_BEGIN_WKR");
   string stopSiteName ("ANNOTATE_SITE_END_WKR");
   string startTaskName("ANNOTATE_TASK_BEGIN_WKR");
@@ -614,10 +856,55 @@ VOID Image(IMG img, VOID *v)
 
 VOID Fini(INT32 code, VOID *v)
 {
-  if (debugging) printAndClearStats();
+  annotatedSites.FinishSites();
+  if (debugging) {
+    printStats();
+    threadBuffers.PrintStats();
+  }
   annotatedSites.PrintStats(cout);
   annotatedSites.PrintStats(siteReportFile);
   siteReportFile.close();
+
+  std::ofstream trafficReportFile(KNOB_TRAFFIC_REPORT.Value().c_str());
+  annotatedSites.PrintTraffic(trafficReportFile);
+
+  if (classifyMisses) {
+    std::ofstream missClassReportFile(KNOB_MISS_CLASS_REPORT.Value().c_str());
+    annotatedSites.PrintMissClasses(missClassReportFile);
+  }
+
+  if (trackFootprint) {
+    std::ofstream footprintReportFile(KNOB_FOOTPRINT_REPORT.Value().c_str());
+    std::ofstream footprintGrowthFile(KNOB_FOOTPRINT_GROWTH_REPORT.Value().c_str());
+    annotatedSites.PrintFootprints(footprintReportFile, footprintGrowthFile);
+  }
+
+  if (studyLineSizes) {
+    std::ofstream lineSizeReportFile(KNOB_LINE_SIZE_REPORT.Value().c_str());
+    annotatedSites.PrintLineSizes(lineSizeReportFile);
+  }
+
+  if (simulateDram) {
+    std::ofstream dramReportFile(KNOB_DRAM_REPORT.Value().c_str());
+    annotatedSites.PrintDram(dramReportFile);
+  }
+
+  if (simulateTlb) {
+    std::ofstream tlbReportFile(KNOB_TLB_REPORT.Value().c_str());
+    annotatedSites.PrintTlb(tlbReportFile);
+  }
+
+  if (!KNOB_CHECKPOINT_OUT.Value().empty())
+    annotatedSites.SaveCheckpoint(KNOB_CHECKPOINT_OUT.Value().c_str());
+
+  CacheSimulator::ThreadCounters total = totalCounters();
+  double nativeSeconds = timingEstimate.seconds(annotatedSites.ThreadInstructions());
+  if (traceFile && fclose(traceFile) != 0)
+    std::cerr << "Error: failed to write the trace file, it is truncated" << std::endl;
+
+  std::ofstream overheadReportFile(KNOB_OVERHEAD_REPORT.Value().c_str());
+  overheadReport.Print(overheadReportFile, total, annotatedSites.SiteSeconds(), nativeSeconds);
+  if (debugging) overheadReport.Print(cout, total, annotatedSites.SiteSeconds(), nativeSeconds);
 }
 
 VOID InitThreadData(THREADID threadId, CONTEXT *ctxt, INT32 flags, VOID *v)
@@ -626,14 +913,11 @@ VOID InitThreadData(THREADID threadId, CONTEXT *ctxt, INT32 flags, VOID *v)
     return;
 
   if (1 || debugging) printf("Creating thread data for tid %d\n", threadId);
-  PIN_GetLock(&lock, threadId+1);
-  numThreads++;
-
-  PerThreadAddressStore *addressStore = new PerThreadAddressStore();
+  PIN_LockClient();
+  PerThreadAddressStore *addressStore = threadBuffers.add(threadId);
+  PIN_UnlockClient();
 
   PIN_SetThreadData(tlsKey, addressStore, threadId);
-
-  PIN_ReleaseLock(&lock);
 }
 
 VOID CleanThreadData(THREADID threadId, const CONTEXT *ctxt, INT32 flags, VOID *v)
@@ -642,7 +926,6 @@ VOID CleanThreadData(THREADID threadId, const CONTEXT *ctxt, INT32 flags, VOID *
     return;
 
   if (1 || debugging) printf("Cleaning thread data for tid %d\n", threadId);
-  PIN_GetLock(&lock, threadId+1);
   auto addressStore = getThreadData(threadId);
 
   if (addressStore == NULL) {
@@ -650,10 +933,17 @@ VOID CleanThreadData(THREADID threadId, const CONTEXT *ctxt, INT32 flags, VOID *
     assert(0);
   }
 
-  delete addressStore;
+  // simulate what the thread recorded before its buffer is recycled
+  if (addressStore->hasPendingData())
+    SimulateAddresses();
 
-  numThreads--;
-  PIN_ReleaseLock(&lock);
+  PIN_LockClient();
+  addressStore->counters.stopClock();
+  retiredCounters.add(addressStore->counters);
+  threadBuffers.remove(threadId);
+  PIN_UnlockClient();
+
+  PIN_SetThreadData(tlsKey, NULL, threadId);
 }
 
 int main(int argc, char* argv[])
@@ -668,13 +958,59 @@ int main(int argc, char* argv[])
   traceOutFile.open("trace.out.txt");
   traceInFile.open("tace.in.txt");
 
+  classifyMisses = KNOB_CLASSIFY_MISSES.Value();
+  trackFootprint = KNOB_FOOTPRINT.Value();
+  footprintExactLimit = MB(size_t(KNOB_FOOTPRINT_EXACT_MB.Value()));
+  writeAllocate = KNOB_WRITE_ALLOCATE.Value();
+  if      (KNOB_NON_TEMPORAL.Value() == "detect") nonTemporalMode = NonTemporalDetect;
+  else if (KNOB_NON_TEMPORAL.Value() == "ignore") nonTemporalMode = NonTemporalIgnore;
+  else if (KNOB_NON_TEMPORAL.Value() == "all")    nonTemporalMode = NonTemporalAll;
+  else {
+    std::cerr << "Error: -nonTemporal must be detect, ignore or all" << std::endl;
+    return Usage();
+  }
+  studyLineSizes = KNOB_LINE_SIZE_STUDY.Value();
+  selfProfile = KNOB_SELF_PROFILE.Value();
+  detectQsimMagic = KNOB_QSIM_MAGIC.Value();
+
+  if (!KNOB_TRACE_FILE.Value().empty()) {
+    traceFile = fopen(KNOB_TRACE_FILE.Value().c_str(), "wb");
+    if (traceFile == NULL ||
+	fwrite(CacheSimulator::traceFileMagic, sizeof(CacheSimulator::traceFileMagic), 1, traceFile) != 1) {
+      std::cerr << "Error: cannot create trace file " << KNOB_TRACE_FILE.Value() << std::endl;
+      return Usage();
+    }
+  }
+  simulateDram = KNOB_DRAM.Value();
+  if (!dramConfig.parse(KNOB_DRAM_CONFIG.Value()) || !timingEstimate.parse(KNOB_TIMING_ESTIMATE.Value())) {
+    std::cerr << "Error: malformed -dramConfig or -timingEstimate" << std::endl;
+    return Usage();
+  }
+  simulateTlb = KNOB_TLB.Value();
+  if (!tlbConfig.parse(KNOB_TLB_CONFIG.Value()) || !tlbPageSizes.parse(KNOB_TLB_PAGE_REGIONS.Value())) {
+    std::cerr << "Error: malformed -tlbConfig or -tlbPageRegions" << std::endl;
+    return Usage();
+  }
+  annotatedSites.SetWarmSites(KNOB_WARM_SITES.Value());
+  if (!KNOB_CHECKPOINT_IN.Value().empty() &&
+      !annotatedSites.LoadCheckpoint(KNOB_CHECKPOINT_IN.Value().c_str()))
+    return -1;
+
   PIN_InitSymbols();
 
+  if (KNOB_MAX_THREADS.Value() < 1 || KNOB_THREAD_BUFFER_KB.Value() < 1) {
+    std::cerr << "Error: -maxThreads and -threadBufferKB must be at least 1" << std::endl;
+    return Usage();
+  }
+
   tlsKey = PIN_CreateThreadDataKey(0);
+  threadBuffers.initialize(KNOB_MAX_THREADS.Value(), KB(size_t(KNOB_THREAD_BUFFER_KB.Value())),
+			   KNOB_HUGE_PAGE_BUFFERS.Value());
 
   IMG_AddInstrumentFunction(Image, 0);
   // Register Instruction to be called to instrument instructions
   INS_AddInstrumentFunction(Instruction, 0);
+  TRACE_AddInstrumentFunction(Trace, 0);
 
   PIN_AddThreadStartFunction(InitThreadData, 0);
   PIN_AddThreadFiniFunction (CleanThreadData, 0);
@@ -0,0 +1,210 @@
+#ifndef _ADDRESSSTORE_H
+#define _ADDRESSSTORE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include "bufferpool.h"
+#include "cachesim.h"
+#include "selfprofile.h"
+
+class PerThreadAddressStore {
+  size_t *addresses;
+  size_t  count;
+  size_t  max_count;
+  size_t  top;
+  size_t  instructions;	// executed since the last drain
+public:
+  CacheSimulator::ThreadCounters counters;
+  size_t  threadId;
+
+  // addresses is owned by the caller, see ThreadBufferRegistry
+  PerThreadAddressStore(size_t *buffer, size_t bufferSize, size_t tid)
+    : addresses(buffer), count(0), top(0), instructions(0), threadId(tid) {
+    max_count = bufferSize / sizeof(size_t);
+  }
+
+  ~PerThreadAddressStore() {
+    if (debugging) printf("deleting address store\n");
+  }
+
+  size_t *getBuffer() { return addresses; }
+
+  bool hasPendingData() { return top < count || instructions > 0; }
+
+  void addInstructions(size_t n) { instructions += n; }
+
+  size_t takeInstructions() {
+    size_t n = instructions;
+    instructions = 0;
+    return n;
+  }
+
+  // stores address for the thread and returns if buffer is full
+  bool StoreAddress(char* addr, size_t size, uint32_t type, int threadId) {
+    ASSERTM((size_t(addr) >> (64 - CacheSimulator::accessAddressShift)) == 0,
+	    "address %p does not fit in a buffer entry\n", addr);
+
+    while (size > 0) {
+      size_t chunk = std::min(size, CacheSimulator::maxAccessSize);
+      addresses[count++] = CacheSimulator::packAccess(size_t(addr), chunk, type);
+      addr += chunk;
+      size -= chunk;
+    }
+
+    // keep a padding of 64 entries to report buffer filled
+    if (count + 64 >= max_count)
+      return true;
+
+    return false;
+  }
+
+  size_t getAddress() {
+    //if (debugging) printf("current store top: %d, count: %d, max_count: %d\n", top, count, max_count);
+    if (top < count)
+      return addresses[top++];
+
+    top = 0; count = 0;
+    return 0;
+  }
+};
+
+// Address stores of all live application threads, indexed by thread id.
+// Pin reuses the ids of exited threads, so the id space stays sparse but
+// bounded; buffers of exited threads are recycled through the pool.
+// Not thread safe; the Pin tool calls it under the client lock, which also
+// serializes draining.
+class ThreadBufferRegistry {
+  BufferPool pool;
+  size_t     maxThreads;
+
+  std::vector<PerThreadAddressStore*> byThreadId;	// NULL for dead ids
+  std::vector<PerThreadAddressStore*> live;
+
+public:
+  ThreadBufferRegistry() : maxThreads(0) {}
+
+  void initialize(size_t maxLiveThreads, size_t bufferSize, bool hugePages) {
+    maxThreads = maxLiveThreads;
+    // reserve address space for 16 threads at a time
+    pool.initialize(bufferSize, 16, hugePages);
+  }
+
+  PerThreadAddressStore* add(size_t tid) {
+    if (live.size() == maxThreads) {
+      std::cerr << "Error: more than " << maxThreads << " live threads. Raise -maxThreads." << std::endl;
+      exit(-1);
+    }
+
+    size_t *buffer = (size_t*)pool.acquire();
+    if (buffer == NULL) {
+      std::cerr << "Error: cannot reserve an address buffer for tid " << tid << std::endl;
+      exit(-1);
+    }
+
+    if (tid >= byThreadId.size())
+      byThreadId.resize(tid + 1, NULL);
+    assert(byThreadId[tid] == NULL);
+
+    PerThreadAddressStore *store = new PerThreadAddressStore(buffer, pool.getBufferSize(), tid);
+    byThreadId[tid] = store;
+    live.push_back(store);
+    return store;
+  }
+
+  void remove(size_t tid) {
+    assert(tid < byThreadId.size() && byThreadId[tid] != NULL);
+    PerThreadAddressStore *store = byThreadId[tid];
+    byThreadId[tid] = NULL;
+
+    for (size_t i = 0; i < live.size(); i++) {
+      if (live[i] != store) continue;
+      live[i] = live.back();
+      live.pop_back();
+      break;
+    }
+
+    pool.release(store->getBuffer());
+    delete store;
+  }
+
+  size_t size()                           { return live.size(); }
+  PerThreadAddressStore* operator[](size_t i) { return live[i]; }
+
+  void PrintStats() {
+    printf("thread buffers: %lu live, %lu free, %lu KB reserved\n",
+	   live.size(), pool.getFreeBuffers(), pool.getReservedBytes() / KB(1));
+  }
+};
+
+class AddressStore {
+  PerThreadAddressStore **stores;
+
+  bool   *storeExhausted;
+  size_t numStoresExhausted;
+  size_t numStores;
+  size_t currentIdx;
+  AddressStore();
+
+public:
+  AddressStore(ThreadBufferRegistry &registry) {
+
+    numStores			= registry.size();
+    if (debugging) printf("creating address store for %lu threads\n", numStores);
+    stores				= new PerThreadAddressStore*[numStores];
+    storeExhausted		= new bool[numStores];
+
+    for (size_t i = 0; i < numStores; i++) {
+      stores[i]         =  registry[i];
+      storeExhausted[i] =  false;
+    }
+
+    numStoresExhausted	= 0;
+    currentIdx			= 0;
+  }
+
+  ~AddressStore() {
+    delete [] stores;
+    delete [] storeExhausted;
+  }
+
+  void incrementIndex() {
+    currentIdx++;
+    if (currentIdx == numStores) 
+      currentIdx = 0;
+  }
+
+
+  // return false if all the addresses have been exhausted
+  bool getNextAddress(size_t *addr) {
+		
+    while(numStoresExhausted < numStores) {
+
+      if (storeExhausted[currentIdx] == false) {
+	*addr = (size_t)stores[currentIdx]->getAddress();
+				
+	// current store has exhausted
+	// move to next store
+	if (*addr == 0) { 
+	  if (debugging) printf("store with idx %lu exhausted...\n", currentIdx);
+	  storeExhausted[currentIdx] = true;
+	  numStoresExhausted++;
+
+	  incrementIndex();
+	  continue;
+	}
+
+	return true;
+      }
+      else
+	incrementIndex();
+    }
+
+    return false;
+  }
+};
+
+#endif /* _ADDRESSSTORE_H */
@@ -0,0 +1,242 @@
+// Pin-free benchmark of the simulator core on synthetic address streams.
+//
+//   bench_cachesim [accesses] [footprintMB]
+//
+// Prints one CSV row per benchmark, stream and cache geometry. Host cache
+// misses come from perf_event_open and are -1 where it is not available.
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "cachesim.h"
+#include "addressstore.h"
+
+using namespace CacheSimulator;
+
+bool debugging      = false;
+bool classifyMisses = false;
+bool writeAllocate  = true;
+
+class HostCacheMisses {
+  int fd;
+
+public:
+  HostCacheMisses() {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size           = sizeof(attr);
+    attr.type           = PERF_TYPE_HARDWARE;
+    attr.config         = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled       = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv     = 1;
+    fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+  }
+
+  ~HostCacheMisses() { if (fd >= 0) close(fd); }
+
+  void start() {
+    if (fd < 0) return;
+    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+  }
+
+  long long stop() {
+    if (fd < 0) return -1;
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    long long count;
+    if (read(fd, &count, sizeof(count)) != sizeof(count)) return -1;
+    return count;
+  }
+};
+
+// packed accesses, see packAccess(), and the thread issuing each
+struct Stream {
+  std::string		name;
+  std::vector<size_t>	entries;
+  std::vector<uint8_t>	threads;
+};
+
+static const size_t streamBase  = size_t(1) << 32;
+static const size_t accessBytes = 8;
+static const size_t numThreads  = 8;
+
+// every fourth access is a store
+static AccessType typeOf(size_t i) { return (i % 4 == 3) ? Write : Read; }
+
+static void push(Stream &s, size_t addr, size_t i, size_t thread = 0) {
+  s.entries.push_back(packAccess(addr, accessBytes, typeOf(i)));
+  s.threads.push_back(thread);
+}
+
+static std::vector<Stream> makeStreams(size_t n, size_t footprint) {
+  std::vector<Stream> streams(6);
+  size_t lines = footprint / cacheLineSize;
+  std::mt19937_64 rng(42);
+
+  streams[0].name = "sequential";
+  for (size_t i = 0; i < n; i++)
+    push(streams[0], streamBase + (i * accessBytes) % footprint, i);
+
+  streams[1].name = "strided256";
+  for (size_t i = 0; i < n; i++)
+    push(streams[1], streamBase + (i * 256) % footprint, i);
+
+  streams[2].name = "random";
+  for (size_t i = 0; i < n; i++)
+    push(streams[2], streamBase + (rng() % lines) * cacheLineSize, i);
+
+  // Zipf(0.99) over lines, with popular lines scattered over the footprint
+  streams[3].name = "zipf";
+  std::vector<double> cdf(lines);
+  double sum = 0;
+  for (size_t r = 0; r < lines; r++) cdf[r] = (sum += 1.0 / pow(r + 1, 0.99));
+  std::vector<size_t> rankToLine(lines);
+  for (size_t r = 0; r < lines; r++) rankToLine[r] = r;
+  std::shuffle(rankToLine.begin(), rankToLine.end(), rng);
+  std::uniform_real_distribution<double> uniform(0, sum);
+  for (size_t i = 0; i < n; i++) {
+    size_t r = std::lower_bound(cdf.begin(), cdf.end(), uniform(rng)) - cdf.begin();
+    push(streams[3], streamBase + rankToLine[std::min(r, lines - 1)] * cacheLineSize, i);
+  }
+
+  // a single random cycle through all lines (Sattolo's algorithm)
+  streams[4].name = "pointerchase";
+  std::vector<size_t> next(lines);
+  for (size_t l = 0; l < lines; l++) next[l] = l;
+  for (size_t l = lines - 1; l > 0; l--) std::swap(next[l], next[rng() % l]);
+  for (size_t i = 0, l = 0; i < n; i++, l = next[l])
+    push(streams[4], streamBase + l * cacheLineSize, i);
+
+  // threads walk private slices sequentially, switching every 16 accesses
+  streams[5].name = "multithread";
+  size_t slice = footprint / numThreads;
+  for (size_t i = 0; i < n; i++) {
+    size_t t = (i / 16) % numThreads;
+    size_t k = (i / (16 * numThreads)) * 16 + i % 16;
+    push(streams[5], streamBase + t * slice + (k * accessBytes) % slice, i, t);
+  }
+
+  return streams;
+}
+
+static void report(const char *bench, Stream &s, size_t cacheBytes, size_t accesses,
+		   double seconds, long long hostMisses) {
+  std::cout << bench << "," << s.name << "," << cacheBytes << "," << accesses << "," <<
+    seconds << "," << accesses / seconds << "," << seconds * 1e9 / accesses << "," <<
+    hostMisses << "," << (hostMisses < 0 ? -1.0 : double(hostMisses) / accesses) << std::endl;
+}
+
+typedef std::chrono::steady_clock Clock;
+
+static double secondsSince(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// CacheHitCounter::insert alone
+static void benchCounter(Stream &s, size_t cacheBytes) {
+  CacheHitCounter counter;
+  counter.initialize(cacheBytes);
+
+  HostCacheMisses misses;
+  misses.start();
+  Clock::time_point start = Clock::now();
+  for (size_t i = 0; i < s.entries.size(); i++) {
+    size_t line = accessAddress(s.entries[i]) >> cacheLineSizeLog2;
+    counter.insert(line, line ^ (line >> 13), accessType(s.entries[i]));
+  }
+  double seconds = secondsSince(start);
+  report("counter", s, cacheBytes, s.entries.size(), seconds, misses.stop());
+}
+
+// CacheHitProfile::insert for every line of every access
+static void benchProfile(Stream &s) {
+  CacheHitProfile profile(false);
+
+  HostCacheMisses misses;
+  misses.start();
+  Clock::time_point start = Clock::now();
+  for (size_t i = 0; i < s.entries.size(); i++) {
+    size_t addr = accessAddress(s.entries[i]);
+    size_t lo   = addr >> cacheLineSizeLog2;
+    size_t hi   = (addr + accessSize(s.entries[i]) - 1) >> cacheLineSizeLog2;
+    for (size_t line = lo; line <= hi; line++)
+      profile.insert(line, accessType(s.entries[i]));
+  }
+  double seconds = secondsSince(start);
+  report("profile", s, profile.getCacheBytes(), s.entries.size(), seconds, misses.stop());
+}
+
+// the loop of SimulateAddresses() in the Pin tool
+static void drain(ThreadBufferRegistry &registry, CacheHitProfile &profile) {
+  AddressStore addressStore(registry);
+  size_t entry;
+  while (addressStore.getNextAddress(&entry)) {
+    size_t addr = accessAddress(entry);
+    size_t lo   = addr >> cacheLineSizeLog2;
+    size_t hi   = (addr + accessSize(entry) - 1) >> cacheLineSizeLog2;
+    for (size_t line = lo; line <= hi; line++)
+      profile.insert(line, accessType(entry));
+  }
+}
+
+// per-thread buffers filled as noteMemoryAccess() does, drained through
+// AddressStore whenever one of them fills up
+static void benchDrain(Stream &s) {
+  CacheHitProfile      profile(false);
+  ThreadBufferRegistry registry;
+  registry.initialize(numThreads, MB(1), false);
+  std::vector<PerThreadAddressStore*> stores;
+  for (size_t t = 0; t < numThreads; t++) stores.push_back(registry.add(t));
+
+  HostCacheMisses misses;
+  misses.start();
+  Clock::time_point start = Clock::now();
+  for (size_t i = 0; i < s.entries.size(); i++) {
+    size_t e = s.entries[i];
+    if (stores[s.threads[i]]->StoreAddress((char*)accessAddress(e), accessSize(e), accessType(e), s.threads[i]))
+      drain(registry, profile);
+  }
+  drain(registry, profile);
+  double seconds = secondsSince(start);
+  report("drain", s, profile.getCacheBytes(), s.entries.size(), seconds, misses.stop());
+
+  for (size_t t = 0; t < numThreads; t++) registry.remove(t);
+}
+
+static const size_t geometries[] = { MB(1), MB(8), MB(32) };
+
+int main(int argc, char* argv[])
+{
+  size_t accesses    = argc > 1 ? strtoul(argv[1], NULL, 0) : 4 << 20;
+  size_t footprintMB = argc > 2 ? strtoul(argv[2], NULL, 0) : 64;
+  // a footprint of 1 MB gives every multithread slice whole lines
+  if (accesses == 0 || footprintMB == 0) {
+    std::cerr << "usage: " << argv[0] << " [accesses] [footprintMB], both at least 1" << std::endl;
+    return -1;
+  }
+  size_t footprint = MB(footprintMB);
+
+  std::vector<Stream> streams = makeStreams(accesses, footprint);
+
+  std::cout << "benchmark,stream,cache_bytes,accesses,seconds,accesses_per_sec,ns_per_access,"
+    "host_cache_misses,host_misses_per_access" << std::endl;
+  for (size_t i = 0; i < streams.size(); i++) {
+    for (size_t g = 0; g < sizeof(geometries) / sizeof(geometries[0]); g++)
+      benchCounter(streams[i], geometries[g]);
+    benchProfile(streams[i]);
+    benchDrain(streams[i]);
+  }
+
+  return 0;
+}
@@ -0,0 +1,100 @@
+#ifndef _BUFFERPOOL_H
+#define _BUFFERPOOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <utility>
+#include <vector>
+
+// Fixed size buffers carved out of large anonymous mappings.
+//
+// Arenas are reserved with MAP_NORESERVE and never touched by the pool, so
+// a buffer only costs memory once its owner writes to it: threads that
+// never record an access never commit their buffer. Released buffers are
+// kept on a LIFO free list and handed to the next thread, which gets pages
+// that are already committed instead of faulting in new ones.
+//
+// With hugePages set, arenas are 2 MB aligned and advised for transparent
+// huge pages; buffers smaller than 2 MB then share huge pages.
+//
+// The pool is not thread safe; callers serialize acquire() and release().
+class BufferPool {
+  static const size_t hugePageSize = size_t(1) << 21;
+
+  size_t bufferSize;
+  size_t buffersPerArena;
+  bool   hugePages;
+
+  char   *arena;		// arena buffers are currently carved from
+  size_t carved;		// buffers handed out from arena so far
+
+  std::vector<void*>                    freeBuffers;
+  std::vector<std::pair<void*, size_t>> mappings;
+
+  BufferPool(BufferPool const &);
+  BufferPool & operator =(BufferPool const &);
+
+  bool newArena() {
+    size_t length = bufferSize * buffersPerArena;
+    size_t slack  = hugePages ? hugePageSize : 0;
+
+    void *map = mmap(NULL, length + slack, PROT_READ | PROT_WRITE,
+		     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (map == MAP_FAILED)
+      return false;
+    mappings.push_back(std::make_pair(map, length + slack));
+
+    uintptr_t base = uintptr_t(map);
+    if (hugePages) {
+      base = (base + hugePageSize - 1) & ~(hugePageSize - 1);
+#ifdef MADV_HUGEPAGE
+      madvise((void*)base, length, MADV_HUGEPAGE);
+#endif
+    }
+
+    arena  = (char*)base;
+    carved = 0;
+    return true;
+  }
+
+public:
+  BufferPool() : bufferSize(0), buffersPerArena(0), hugePages(false), arena(NULL), carved(0) {}
+
+  ~BufferPool() {
+    for (size_t i = 0; i < mappings.size(); i++)
+      munmap(mappings[i].first, mappings[i].second);
+  }
+
+  void initialize(size_t bufferBytes, size_t perArena, bool useHugePages) {
+    // keep every buffer page aligned so recycling never splits a page
+    bufferSize      = (bufferBytes + 4095) & ~size_t(4095);
+    buffersPerArena = perArena;
+    hugePages       = useHugePages;
+  }
+
+  // returns NULL if no more address space can be reserved
+  void* acquire() {
+    if (!freeBuffers.empty()) {
+      void *buffer = freeBuffers.back();
+      freeBuffers.pop_back();
+      return buffer;
+    }
+
+    if (arena == NULL || carved == buffersPerArena)
+      if (!newArena())
+	return NULL;
+
+    return arena + bufferSize * carved++;
+  }
+
+  void release(void *buffer) {
+    freeBuffers.push_back(buffer);
+  }
+
+  size_t getBufferSize()    { return bufferSize; }
+  size_t getReservedBytes() { return mappings.size() * bufferSize * buffersPerArena; }
+  size_t getFreeBuffers()   { return freeBuffers.size(); }
+};
+
+#endif /* _BUFFERPOOL_H */
@@ -0,0 +1,471 @@
+#ifndef _CACHESIM_H
+#define _CACHESIM_H
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <iostream>
+#include <string>
+
+#include "missclassifier.h"
+#include "dram.h"
+
+#define KB(x) ((x)*1024)
+#define MB(x) ((x)*1024*1024)
+
+#define ASSERTM(condition, ...) do { \
+	if (!(condition)) { printf(__VA_ARGS__); } \
+assert ((condition)); } while(false)
+
+// defined once by every program using the simulator
+extern bool debugging;
+
+// options of the simulated caches, set before any cache is created
+extern bool classifyMisses;
+extern bool writeAllocate;
+
+namespace CacheSimulator {
+
+  static const size_t cacheLineSizeLog2 = 6;
+  static const size_t cacheLineSize     = 1 << cacheLineSizeLog2;
+
+  enum AccessType { Read = 0, Write = 1, NonTemporalWrite = 3 };
+
+  // Address buffers hold one word per access: the access type in the low
+  // two bits, the size in the next 14 and the byte address in the top 48,
+  // which covers the user half of a 4 level page table. Larger accesses
+  // are split into several entries.
+  static const size_t accessTypeBits     = 2;
+  static const size_t accessSizeBits     = 14;
+  static const size_t accessAddressShift = accessTypeBits + accessSizeBits;
+  static const size_t maxAccessSize      = (size_t(1) << accessSizeBits) - 1;
+
+  static inline size_t packAccess(size_t addr, size_t size, size_t type) {
+    return (addr << accessAddressShift) | (size << accessTypeBits) | type;
+  }
+
+  static inline size_t     accessAddress(size_t entry) { return entry >> accessAddressShift; }
+  static inline size_t     accessSize(size_t entry)    { return (entry >> accessTypeBits) & maxAccessSize; }
+  static inline AccessType accessType(size_t entry)    { return AccessType(entry & ((1 << accessTypeBits) - 1)); }
+
+  // A captured trace file is this magic followed by packed entries in the
+  // order they were simulated.
+  static const char traceFileMagic[8] = { 'P', 'C', 'S', 'T', 'R', 'C', 'E', '1' };
+
+  // Each way holds the line number shifted left by one with the dirty bit
+  // in bit 0, so 0 still marks an empty way.
+  class CacheHitCounter {
+
+    static const size_t  depthLog2 = 4;
+    static const size_t  depth     = 1 << depthLog2;
+
+    // Streaming and write-through stores to a line are merged in one of a
+    // few write-combining buffers and reach memory as a single write when
+    // the buffer is reused, the line is accessed normally or the site ends.
+    static const size_t  combineBuffers = 4;
+    struct CombineBuffer {
+      size_t   line;		// line number + 1, 0 if free
+      uint64_t bytes;		// bytes of the line written
+      bool     through;		// write-through rather than streaming
+    };
+
+    size_t  widthLog2;
+    size_t  width;
+    size_t  widthMask;
+    size_t  hits;
+    size_t  misses;
+    size_t  fillBytes;		// lines read from memory on misses
+    size_t  writebackBytes;	// dirty lines evicted
+    size_t  writeThroughBytes;	// write misses that did not allocate
+    size_t  nonTemporalBytes;	// streaming stores that bypassed the cache
+    size_t  addressesLen;
+    size_t* addresses;
+    size_t  maxSize;
+    MissClassifier* classifier;	// NULL unless misses are classified
+    DramModel*      memory;		// next level, NULL if not simulated
+    CombineBuffer   combining[combineBuffers];
+    size_t          combineUsed;	// buffers holding a line
+    size_t          nextCombine;	// next buffer to reuse
+
+    CacheHitCounter & operator =(CacheHitCounter const & CacheHitProfile1);
+    CacheHitCounter(CacheHitCounter const &);
+
+    // seed the shadow cache with the current contents, LRU ways first
+    void warmClassifier() {
+      if (!classifier) return;
+      classifier->clearLines();
+      for (size_t r = depth; r-- > 0; )
+	for (size_t col = 0; col < width; col++)
+	  if (addresses[col*depth + r] != 0)
+	    classifier->warm(addresses[col*depth + r] >> 1);
+    }
+
+    static uint64_t byteMask(size_t offset, size_t size) {
+      uint64_t bits = size >= 64 ? ~uint64_t(0) : (uint64_t(1) << size) - 1;
+      return bits << offset;
+    }
+
+    void flushCombined(CombineBuffer &b) {
+      if (b.line == 0) return;
+      size_t bytes = __builtin_popcountll(b.bytes);
+      if (b.through) writeThroughBytes += bytes;
+      else           nonTemporalBytes  += bytes;
+      if (memory) memory->access(b.line - 1, true);
+      b.line  = 0;
+      b.bytes = 0;
+      combineUsed--;
+    }
+
+    void combineWrite(size_t cacheLine, size_t offset, size_t size, bool through) {
+      CombineBuffer *b = NULL;
+      for (size_t i = 0; i < combineBuffers && !b; i++)
+	if (combining[i].line == cacheLine + 1) b = &combining[i];
+
+      if (b && b->through != through) flushCombined(*b);
+      if (!b || b->line == 0) {
+	if (!b) {
+	  b = &combining[nextCombine];
+	  nextCombine = (nextCombine + 1) % combineBuffers;
+	  flushCombined(*b);
+	}
+	b->line    = cacheLine + 1;
+	b->through = through;
+	combineUsed++;
+      }
+      b->bytes |= byteMask(offset, size);
+    }
+
+    // a normal access to a line drains its write-combining buffer first
+    void flushCombined(size_t cacheLine) {
+      for (size_t i = 0; i < combineBuffers; i++)
+	if (combining[i].line == cacheLine + 1) flushCombined(combining[i]);
+    }
+
+    // a streaming store bypasses the cache and evicts any cached copy,
+    // writing it back first if it is dirty; it counts as a hit if the line
+    // was resident
+    void streamLine(size_t* c, size_t cacheLine, size_t offset, size_t size) {
+      combineWrite(cacheLine, offset, size, false);
+      if (classifier) classifier->evict(cacheLine);
+      for (size_t r = 0; r < depth; r++) {
+	if ((c[r] >> 1) != cacheLine) continue;
+	if (c[r] & 1) writeBack(c[r] >> 1);
+	for (; r < depth - 1; r++) c[r] = c[r+1];
+	c[depth-1] = 0;
+	hits++;
+	return;
+      }
+      misses++;
+    }
+
+    void writeBack(size_t cacheLine) {
+      writebackBytes += cacheLineSize;
+      if (memory) memory->access(cacheLine, true);
+    }
+
+  public:
+    CacheHitCounter() : classifier(NULL), memory(NULL), combineUsed(0), nextCombine(0) {
+      memset(combining, 0, sizeof(combining));
+    }
+    CacheHitCounter(size_t maxSizeLog2) : classifier(NULL), memory(NULL), combineUsed(0), nextCombine(0) {
+      memset(combining, 0, sizeof(combining));
+      maxSize         = size_t(1)<<maxSizeLog2;
+      widthLog2       = maxSizeLog2 - cacheLineSizeLog2 - depthLog2;
+      width           = size_t(1)<<widthLog2;
+      widthMask       = width-1;
+      addresses       = new size_t[addressesLen];
+
+      clear();
+    }
+
+    void initialize(size_t size) {
+      maxSize         = size;
+      width           = size / ((1<<depthLog2) * cacheLineSize);
+      widthMask       = width-1;
+      addressesLen    = depth*width;
+
+      addresses	      = new size_t[addressesLen];
+
+      clear();
+    }
+
+    void attachMemory(DramModel *dram) {
+      memory = dram;
+    }
+
+    void enableMissClassification() {
+      if (!classifier)
+	classifier = new MissClassifier(maxSize / cacheLineSize);
+    }
+
+    void clear() {
+      hits   = 0;
+      misses = 0;
+      fillBytes = writebackBytes = writeThroughBytes = nonTemporalBytes = 0;
+      memset(combining, 0, sizeof(combining));
+      combineUsed = nextCombine = 0;
+      for (size_t i = 0; i < addressesLen; i++) addresses[i] = 0;
+      if (classifier) classifier->clear();
+    }
+
+    // sends all partially combined writes to memory
+    void flushWrites() {
+      for (size_t i = 0; i < combineBuffers && combineUsed; i++) flushCombined(combining[i]);
+    }
+
+    void clearAddresses() 
+    {
+      flushWrites();
+      memset(addresses, 0, addressesLen * sizeof(size_t));
+      if (classifier) classifier->clearLines();
+    }
+
+    void copyAddresses(CacheHitCounter &other)
+    {
+      assert(other.addressesLen == addressesLen);
+      flushWrites();
+      memcpy(addresses, other.addresses, addressesLen * sizeof(size_t));
+      warmClassifier();
+    }
+
+    // Checkpoint layout: maxSize, addressesLen, then for every set the
+    // number of valid ways followed by their tags. insert() only ever
+    // shifts tags towards the LRU end, so valid ways are always a prefix
+    // of the set and partially warm caches stay small on disk.
+    bool save(FILE *fp) {
+      uint64_t geometry[2] = { maxSize, addressesLen };
+      if (fwrite(geometry, sizeof(geometry), 1, fp) != 1) return false;
+
+      for (size_t col = 0; col < width; col++) {
+	size_t* c     = &addresses[col*depth];
+	uint8_t valid = 0;
+	while (valid < depth && c[valid] != 0) valid++;
+
+	if (fwrite(&valid, sizeof(valid), 1, fp) != 1) return false;
+	if (fwrite(c, sizeof(size_t), valid, fp) != valid) return false;
+      }
+      return true;
+    }
+
+    bool load(FILE *fp) {
+      uint64_t geometry[2];
+      if (fread(geometry, sizeof(geometry), 1, fp) != 1) return false;
+      if (geometry[0] != maxSize || geometry[1] != addressesLen) {
+	std::cerr << "Error: checkpoint geometry " << geometry[0] << "/" << geometry[1] <<
+	  " does not match cache " << maxSize << "/" << addressesLen << std::endl;
+	return false;
+      }
+
+      clearAddresses();
+      for (size_t col = 0; col < width; col++) {
+	size_t* c = &addresses[col*depth];
+	uint8_t valid;
+	if (fread(&valid, sizeof(valid), 1, fp) != 1 || valid > depth) return false;
+	if (fread(c, sizeof(size_t), valid, fp) != valid) return false;
+      }
+      warmClassifier();
+      return true;
+    }
+
+    ~CacheHitCounter() {
+      delete [] addresses;
+      delete classifier;
+    }
+
+    // offset and size are the bytes of the line accessed
+    void insert(size_t cacheLine, size_t hashedCacheLine, AccessType type,
+		size_t offset = 0, size_t size = cacheLineSize) {
+
+      size_t col = hashedCacheLine % width; 
+      size_t* c  = &addresses[col*depth];
+      if (type == NonTemporalWrite) {
+	streamLine(c, cacheLine, offset, size);
+	return;
+      }
+      if (combineUsed) flushCombined(cacheLine);
+
+      size_t  tag = (cacheLine << 1) | (type & Write);
+      size_t  pc  = tag;
+      size_t  r   = 0;
+      for (; r < depth; r++) {
+	size_t oldC = c[r];
+	c[r] = pc;
+	if ((oldC >> 1) == cacheLine) {
+	  c[0] |= oldC & 1;
+	  hits++;
+	  if (classifier) classifier->access(cacheLine, false);
+	  return;
+	}
+	pc = oldC;
+      }
+      misses++;
+
+      // the shadow only follows lines the real cache allocates
+      if ((type & Write) && !writeAllocate) {
+	// undo the allocation, the write goes straight to memory
+	for (r = 0; r < depth - 1; r++) c[r] = c[r+1];
+	c[depth-1] = pc;
+	combineWrite(cacheLine, offset, size, true);
+	return;
+      }
+
+      if (classifier) classifier->access(cacheLine, true);
+      fillBytes += cacheLineSize;
+      if (memory) memory->access(cacheLine, false);
+      if (pc & 1) writeBack(pc >> 1);
+    };
+
+    size_t getHits() {
+      return hits;
+    }
+
+    double getHitRatio() {
+      size_t total = hits + misses;
+
+      return total ? (double)hits / total : 0;
+    }
+
+    double getMissRatio() {
+      size_t total = hits + misses;
+
+      return total ? (double)misses / total : 0;
+    }
+
+    size_t getTotalAccesses() { return hits + misses; }
+
+    size_t getCacheSize()     { return maxSize / MB(1); }
+    size_t getCacheBytes()    { return maxSize; }
+
+    void PrintTraffic(std::ostream &os) {
+      os << ", " << getCacheSize() << ", " << fillBytes << ", " << writebackBytes << ", " <<
+	writeThroughBytes << ", " << nonTemporalBytes;
+    }
+
+    void PrintMissClasses(std::ostream &os) {
+      if (!classifier) return;
+      os << ", " << getCacheSize() << ", " << classifier->getCompulsory() << ", " <<
+	classifier->getCapacity() << ", " << classifier->getConflict();
+    }
+
+    void PrintConfig() {
+      printf("CacheSize %lu, width %lu, addressesLen %lu\n", maxSize / MB(1), width, addressesLen);
+    }
+  };
+
+  class CacheHitProfile {
+    // 1M, 2M, 4M, 6M, 8M, 10M, 12M, 14M, 16M
+    static const size_t numberOfCacheConfigs = 1;
+    CacheHitCounter	_hitCounter[numberOfCacheConfigs];
+		
+  public:
+    // classify is off for profiles that only hold checkpointed state
+    CacheHitProfile(bool classify = classifyMisses)
+    {
+      // 1M, 2M, 4M, 6M, 8M, 10M, 12M, 14M, 16M
+      size_t cacheSize = MB(8);
+      _hitCounter[0].initialize(cacheSize);
+      cacheSize = MB(2);
+      //#pragma omp parallel for shared(cacheSize)
+      for (size_t configIdx = 1; configIdx < numberOfCacheConfigs; configIdx++) {
+	_hitCounter[configIdx].initialize(cacheSize);
+	cacheSize += MB(2);
+      }
+
+      if (classify)
+	for (size_t configIdx = 0; configIdx < numberOfCacheConfigs; configIdx++)
+	  _hitCounter[configIdx].enableMissClassification();
+    }
+
+    void PrintGranularity(std::ostream & os) {
+      for (size_t configIdx = 0; configIdx < numberOfCacheConfigs; configIdx++) {
+	os << ", " << _hitCounter[configIdx].getCacheSize();
+      }
+    }
+
+    void clear() {
+      for (size_t configIdx = 0; configIdx < numberOfCacheConfigs; configIdx++) 
+	_hitCounter[configIdx].clear();
+    }
+
+    void clearAddresses() {
+      for (size_t configIdx = 0; configIdx < numberOfCacheConfigs; configIdx++) 
+	_hitCounter[configIdx].clearAddresses();
+    }
+
+    size_t getCacheBytes() { return _hitCounter[0].getCacheBytes(); }
+
+    // misses of the first config go on to memory
+    void attachMemory(DramModel *dram) {
+      _hitCounter[0].attachMemory(dram);
+    }
+
+    void copyAddresses(CacheHitProfile &other) {
+      for (size_t configIdx = 0; configIdx < numberOfCacheConfigs; configIdx++) 
+	_hitCounter[configIdx].copyAddresses(other._hitCounter[configIdx]);
+    }
+
+    bool save(FILE *fp) {
+      uint32_t numConfigs = numberOfCacheConfigs;
+      if (fwrite(&numConfigs, sizeof(numConfigs), 1, fp) != 1) return false;
+      for (size_t configIdx = 0; configIdx < numberOfCacheConfigs; configIdx++) 
+	if (!_hitCounter[configIdx].save(fp)) return false;
+      return true;
+    }
+
+    bool load(FILE *fp) {
+      uint32_t numConfigs;
+      if (fread(&numConfigs, sizeof(numConfigs), 1, fp) != 1) return false;
+      if (numConfigs != numberOfCacheConfigs) {
+	std::cerr << "Error: checkpoint has " << numConfigs << " cache configs, expected " <<
+	  numberOfCacheConfigs << std::endl;
+	return false;
+      }
+      for (size_t configIdx = 0; configIdx < numberOfCacheConfigs; configIdx++) 
+	if (!_hitCounter[configIdx].load(fp)) return false;
+      return true;
+    }
+
+    void insert(size_t cacheLine, AccessType type, size_t offset = 0, size_t size = cacheLineSize) {
+      size_t hashedCacheLine = cacheLine ^ (cacheLine>>13);
+			  
+      for (size_t configIdx = 0; configIdx < numberOfCacheConfigs; configIdx++) 
+	_hitCounter[configIdx].insert(cacheLine, hashedCacheLine, type, offset, size);
+    }
+
+    void flushWrites() {
+      for (size_t configIdx = 0; configIdx < numberOfCacheConfigs; configIdx++)
+	_hitCounter[configIdx].flushWrites();
+    }
+
+    void PrintConfigs() {
+      for (size_t configIdx = 0; configIdx < numberOfCacheConfigs; configIdx++)
+	_hitCounter[configIdx].PrintConfig();
+    }
+
+    void printHitRatios(std::ostream &os, std::string& name) {
+      os << name;
+      for (size_t configIdx = 0; configIdx < numberOfCacheConfigs; configIdx++)
+	os << "," << _hitCounter[configIdx].getHitRatio();
+      os << ", " << _hitCounter[0].getTotalAccesses() << std::endl;
+    }
+
+    // one row per site: size and memory traffic in bytes for every config
+    void printTraffic(std::ostream &os, std::string& name) {
+      os << name;
+      for (size_t configIdx = 0; configIdx < numberOfCacheConfigs; configIdx++)
+	_hitCounter[configIdx].PrintTraffic(os);
+      os << std::endl;
+    }
+
+    // one row per site: size, compulsory, capacity, conflict for every config
+    void printMissClasses(std::ostream &os, std::string& name) {
+      os << name;
+      for (size_t configIdx = 0; configIdx < numberOfCacheConfigs; configIdx++)
+	_hitCounter[configIdx].PrintMissClasses(os);
+      os << std::endl;
+    }
+  };
+};	// namespace
+
+#endif /* _CACHESIM_H */
@@ -0,0 +1,197 @@
+#ifndef _DRAM_H
+#define _DRAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace CacheSimulator {
+
+  // Parses a comma separated list of name=value pairs, calling
+  // set(name, value) for each. Returns false if set() rejects an item.
+  template<class F> bool parseKeyValues(const std::string &spec, F set) {
+    size_t begin = 0;
+    while (begin < spec.size()) {
+      size_t end = spec.find(',', begin);
+      if (end == std::string::npos) end = spec.size();
+
+      std::string item = spec.substr(begin, end - begin);
+      size_t eq = item.find('=');
+      if (eq == std::string::npos || !set(item.substr(0, eq), item.substr(eq + 1)))
+	return false;
+      begin = end + 1;
+    }
+    return true;
+  }
+
+  static inline bool isPowerOfTwo(size_t x) { return x && !(x & (x - 1)); }
+
+  static inline size_t log2Of(size_t x) {
+    size_t l = 0;
+    while ((size_t(1) << l) < x) l++;
+    return l;
+  }
+
+  // How fast the profiled code would run natively, used to turn per
+  // instruction counts into rates.
+  struct TimingEstimate {
+    double ipc;
+    double ghz;
+
+    TimingEstimate() : ipc(1.0), ghz(3.0) {}
+
+    // spec is e.g. ipc=1.5,ghz=2.6
+    bool parse(const std::string &spec) {
+      return parseKeyValues(spec, [this](const std::string &name, const std::string &value) {
+	  double v = strtod(value.c_str(), NULL);
+	  if (v <= 0) return false;
+	  if      (name == "ipc") ipc = v;
+	  else if (name == "ghz") ghz = v;
+	  else return false;
+	  return true;
+	});
+    }
+
+    double seconds(size_t instructions) { return instructions / (ipc * ghz * 1e9); }
+  };
+
+  // DRAM organisation and the order in which line address bits select
+  // column, channel, bank, rank and row, least significant field first.
+  struct DramConfig {
+    enum Field { Column, Channel, Bank, Rank, Row, numFields };
+
+    size_t	channels, ranks, banks, rowBytes;
+    size_t	mtps;			// transfers per second per channel, in millions
+    bool	xorBanks;		// permutation based bank interleaving
+    std::vector<Field> mapping;
+
+    DramConfig() : channels(2), ranks(2), banks(16), rowBytes(8192), mtps(3200), xorBanks(true) {
+      parseMapping("co:ch:ba:ra:ro");
+    }
+
+    bool parseMapping(const std::string &spec) {
+      static const char *names[numFields] = { "co", "ch", "ba", "ra", "ro" };
+      std::vector<Field> order;
+      for (size_t begin = 0; begin < spec.size(); ) {
+	size_t end = spec.find(':', begin);
+	if (end == std::string::npos) end = spec.size();
+
+	std::string name = spec.substr(begin, end - begin);
+	size_t f = 0;
+	while (f < numFields && name != names[f]) f++;
+	if (f == numFields) return false;
+	for (size_t i = 0; i < order.size(); i++)
+	  if (order[i] == Field(f)) return false;
+	order.push_back(Field(f));
+	begin = end + 1;
+      }
+      if (order.size() != numFields || order.back() != Row) return false;
+      mapping = order;
+      return true;
+    }
+
+    // spec is e.g. channels=4,ranks=1,banks=32,rowBytes=4096,mtps=4800,
+    // xor=0,map=co:ch:ba:ra:ro
+    bool parse(const std::string &spec) {
+      bool ok = parseKeyValues(spec, [this](const std::string &name, const std::string &value) {
+	  if (name == "map") return parseMapping(value);
+
+	  size_t v = strtoul(value.c_str(), NULL, 0);
+	  if      (name == "channels") channels = v;
+	  else if (name == "ranks")    ranks    = v;
+	  else if (name == "banks")    banks    = v;
+	  else if (name == "rowBytes") rowBytes = v;
+	  else if (name == "mtps")     mtps     = v;
+	  else if (name == "xor")      xorBanks = v != 0;
+	  else return false;
+	  return true;
+	});
+      return ok && isPowerOfTwo(channels) && isPowerOfTwo(ranks) && isPowerOfTwo(banks) &&
+	isPowerOfTwo(rowBytes) && rowBytes >= 64 && mtps > 0;
+    }
+
+    // 64 bit wide channels
+    double peakBytesPerSecond() { return double(channels) * mtps * 1e6 * 8; }
+  };
+
+  // Open page DRAM fed with the lines that miss or are written back from
+  // the last simulated cache level. Every access is classified as a row
+  // buffer hit, an access to a precharged bank (row empty), or a bank
+  // conflict that has to close another row first.
+  class DramModel {
+    static const uint64_t closedRow = ~uint64_t(0);
+
+    DramConfig		  &config;
+    size_t		  fieldBits[DramConfig::numFields];
+    std::vector<uint64_t> openRow;	// per channel, rank and bank
+
+    size_t reads, writes, rowHits, rowEmpty, rowConflicts;
+
+    DramModel & operator =(DramModel const &);
+    DramModel(DramModel const &);
+
+  public:
+    DramModel(DramConfig &dramConfig) : config(dramConfig) {
+      fieldBits[DramConfig::Column]  = log2Of(config.rowBytes / 64);
+      fieldBits[DramConfig::Channel] = log2Of(config.channels);
+      fieldBits[DramConfig::Bank]    = log2Of(config.banks);
+      fieldBits[DramConfig::Rank]    = log2Of(config.ranks);
+      fieldBits[DramConfig::Row]     = 64;
+      openRow.resize(config.channels * config.ranks * config.banks);
+      clear();
+    }
+
+    void clear() {
+      reads = writes = rowHits = rowEmpty = rowConflicts = 0;
+      clearBanks();
+    }
+
+    void clearBanks() {
+      for (size_t i = 0; i < openRow.size(); i++) openRow[i] = closedRow;
+    }
+
+    void access(size_t cacheLine, bool isWrite) {
+      uint64_t field[DramConfig::numFields];
+      uint64_t bits = cacheLine;
+      for (size_t i = 0; i < config.mapping.size(); i++) {
+	DramConfig::Field f = config.mapping[i];
+	if (fieldBits[f] >= 64) { field[f] = bits; break; }
+	field[f] = bits & ((uint64_t(1) << fieldBits[f]) - 1);
+	bits >>= fieldBits[f];
+      }
+
+      uint64_t bank = field[DramConfig::Bank];
+      if (config.xorBanks)
+	bank ^= field[DramConfig::Row] & (config.banks - 1);
+
+      uint64_t &open = openRow[(field[DramConfig::Channel] * config.ranks +
+				field[DramConfig::Rank]) * config.banks + bank];
+      if (open == field[DramConfig::Row]) rowHits++;
+      else if (open == closedRow)         rowEmpty++;
+      else                                rowConflicts++;
+      open = field[DramConfig::Row];
+
+      if (isWrite) writes++; else reads++;
+    }
+
+    // instructions is the total over all threads, threadInstructions
+    // those of the busiest thread, which bound the run time
+    void PrintStats(std::ostream &os, std::string &name, size_t instructions, size_t threadInstructions,
+		    TimingEstimate &timing) {
+      size_t accesses = reads + writes;
+      size_t bytes    = accesses * 64;
+      double seconds  = timing.seconds(threadInstructions);
+      double bps      = seconds > 0 ? bytes / seconds : 0;
+
+      os << name << ", " << instructions << ", " << threadInstructions << ", " << reads << ", " << writes << ", " <<
+	(accesses ? double(rowHits) / accesses : 0) << ", " << rowEmpty << ", " << rowConflicts << ", " <<
+	(instructions ? 1000.0 * bytes / instructions : 0) << ", " << bps / 1e9 << ", " <<
+	bps / config.peakBytesPerSecond() << std::endl;
+    }
+  };
+};	// namespace
+
+#endif /* _DRAM_H */
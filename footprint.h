@@ -0,0 +1,190 @@
+#ifndef _FOOTPRINT_H
+#define _FOOTPRINT_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace CacheSimulator {
+
+  // Exact set of integers laid out as a two level radix tree: a sparse
+  // directory of dense 4 KB leaf bitmaps, each covering 2^15 consecutive
+  // keys. For line numbers a leaf covers 2 MB of address space, so memory
+  // stays proportional to the number of 2 MB regions touched.
+  class SparseBitmap {
+    static const size_t leafBitsLog2 = 15;
+    static const size_t leafWords    = (size_t(1) << leafBitsLog2) / 64;
+
+    std::unordered_map<size_t, uint64_t*> leaves;
+    size_t	count;
+    size_t	lastKey;	// most accesses stay within one leaf
+    uint64_t*	lastLeaf;
+
+    SparseBitmap & operator =(SparseBitmap const &);
+    SparseBitmap(SparseBitmap const &);
+
+  public:
+    SparseBitmap() : count(0), lastKey(0), lastLeaf(NULL) {}
+    ~SparseBitmap() { clear(); }
+
+    // returns true if key was not in the set yet
+    bool insert(size_t key) {
+      size_t leafKey = key >> leafBitsLog2;
+      if (lastLeaf == NULL || leafKey != lastKey) {
+	uint64_t *&leaf = leaves[leafKey];
+	if (leaf == NULL) {
+	  leaf = new uint64_t[leafWords];
+	  memset(leaf, 0, leafWords * sizeof(uint64_t));
+	}
+	lastKey  = leafKey;
+	lastLeaf = leaf;
+      }
+
+      size_t   bit  = key & ((size_t(1) << leafBitsLog2) - 1);
+      uint64_t mask = uint64_t(1) << (bit & 63);
+      uint64_t &w   = lastLeaf[bit >> 6];
+      if (w & mask) return false;
+      w |= mask;
+      count++;
+      return true;
+    }
+
+    void clear() {
+      for (auto it = leaves.begin(); it != leaves.end(); it++)
+	delete [] it->second;
+      leaves.clear();
+      count    = 0;
+      lastLeaf = NULL;
+    }
+
+    template<class F> void forEach(F f) {
+      for (auto it = leaves.begin(); it != leaves.end(); it++)
+	for (size_t w = 0; w < leafWords; w++)
+	  for (uint64_t bits = it->second[w]; bits; bits &= bits - 1)
+	    f((it->first << leafBitsLog2) | (w << 6) | __builtin_ctzll(bits));
+    }
+
+    size_t size()        { return count; }
+    size_t memoryBytes() { return leaves.size() * leafWords * sizeof(uint64_t); }
+  };
+
+  // HyperLogLog cardinality estimator with 2^14 registers (~0.8% error)
+  class HyperLogLog {
+    static const size_t precision = 14;
+    static const size_t registers = size_t(1) << precision;
+
+    std::vector<uint8_t> reg;
+
+    static uint64_t mix(uint64_t x) {
+      x ^= x >> 33; x *= 0xff51afd7ed558ccdULL;
+      x ^= x >> 33; x *= 0xc4ceb9fe1a85ec53ULL;
+      x ^= x >> 33;
+      return x;
+    }
+
+  public:
+    HyperLogLog() : reg(registers, 0) {}
+
+    void insert(uint64_t key) {
+      uint64_t h    = mix(key);
+      size_t   idx  = h >> (64 - precision);
+      uint64_t rest = (h << precision) | (uint64_t(1) << (precision - 1));
+      uint8_t  rank = __builtin_clzll(rest) + 1;
+      if (rank > reg[idx]) reg[idx] = rank;
+    }
+
+    double estimate() {
+      double sum   = 0;
+      size_t zeros = 0;
+      for (size_t i = 0; i < registers; i++) {
+	sum += ldexp(1.0, -reg[i]);
+	if (reg[i] == 0) zeros++;
+      }
+
+      double m = registers;
+      double e = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+      // small range correction
+      if (e <= 2.5 * m && zeros)
+	e = m * log(m / zeros);
+      return e;
+    }
+  };
+
+  // Distinct 64 B lines, 4 KB pages and 2 MB pages touched by a site,
+  // split into reads and writes, plus a sample of the line count every
+  // growthInterval accesses. Lines are tracked exactly until the bitmaps
+  // grow past exactLimit bytes; from then on they are estimated with
+  // HyperLogLog, seeded from the exact sets. Page sets are 64x smaller
+  // and always exact.
+  class Footprint {
+    static const size_t pageLinesLog2     = 12 - 6;
+    static const size_t hugePageLinesLog2 = 21 - 6;
+    static const size_t growthInterval    = size_t(1) << 20;
+
+    size_t	 exactLimit;
+    bool	 exact;
+    SparseBitmap lines, readLines, writeLines;
+    HyperLogLog	 linesHLL, readLinesHLL, writeLinesHLL;
+    SparseBitmap pages, hugePages;
+
+    size_t	 accesses;
+    std::vector<std::pair<size_t, size_t> > growth;
+
+    Footprint & operator =(Footprint const &);
+    Footprint(Footprint const &);
+
+    void dropExactLines() {
+      lines.forEach     ([this](size_t l) { linesHLL.insert(l);      });
+      readLines.forEach ([this](size_t l) { readLinesHLL.insert(l);  });
+      writeLines.forEach([this](size_t l) { writeLinesHLL.insert(l); });
+      lines.clear();
+      readLines.clear();
+      writeLines.clear();
+      exact = false;
+    }
+
+  public:
+    Footprint(size_t exactLimitBytes) : exactLimit(exactLimitBytes), exact(true), accesses(0) {}
+
+    void insert(size_t cacheLine, bool isWrite) {
+      if (exact) {
+	lines.insert(cacheLine);
+	(isWrite ? writeLines : readLines).insert(cacheLine);
+	if (lines.memoryBytes() + readLines.memoryBytes() + writeLines.memoryBytes() > exactLimit)
+	  dropExactLines();
+      }
+      else {
+	linesHLL.insert(cacheLine);
+	(isWrite ? writeLinesHLL : readLinesHLL).insert(cacheLine);
+      }
+      pages.insert(cacheLine >> pageLinesLog2);
+      hugePages.insert(cacheLine >> hugePageLinesLog2);
+
+      if (++accesses % growthInterval == 0)
+	growth.push_back(std::make_pair(accesses, getLines()));
+    }
+
+    size_t getLines()      { return exact ? lines.size()      : size_t(linesHLL.estimate()); }
+    size_t getReadLines()  { return exact ? readLines.size()  : size_t(readLinesHLL.estimate()); }
+    size_t getWriteLines() { return exact ? writeLines.size() : size_t(writeLinesHLL.estimate()); }
+
+    void PrintStats(std::ostream &os, std::string &name) {
+      os << name << ", " << getLines() << ", " << pages.size() << ", " << hugePages.size() <<
+	", " << getReadLines() << ", " << getWriteLines() << ", " << (exact ? "exact" : "estimated") << std::endl;
+    }
+
+    void PrintGrowth(std::ostream &os, std::string &name) {
+      for (size_t i = 0; i < growth.size(); i++)
+	os << name << ", " << growth[i].first << ", " << growth[i].second << std::endl;
+      os << name << ", " << accesses << ", " << getLines() << std::endl;
+    }
+  };
+};	// namespace
+
+#endif /* _FOOTPRINT_H */
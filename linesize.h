@@ -0,0 +1,187 @@
+#ifndef _LINESIZE_H
+#define _LINESIZE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace CacheSimulator {
+
+  // A 16 way LRU cache of fixed capacity with an arbitrary line size of up
+  // to 256 B. The line may be split into sectors that are fetched on
+  // demand, so a hit on the tag can still miss on the sector. Every line
+  // remembers which of its bytes were touched; when it is evicted the
+  // fraction touched goes into an eighths histogram.
+  class LineSizeModel {
+    static const size_t ways        = 16;
+    static const size_t maxLineSize = 256;
+    static const size_t buckets     = 8;
+
+    struct Line {
+      size_t   tag;			// line number + 1, 0 if empty
+      uint32_t sectors;			// valid sectors
+      uint64_t touched[maxLineSize / 64];	// bytes accessed
+    };
+
+    size_t	lineSizeLog2;
+    size_t	sectorSizeLog2;
+    size_t	sets;
+    std::vector<Line> lines;
+
+    size_t	accesses, misses, sectorMisses, fetchedBytes;
+    size_t	evicted, evictedTouchedBytes;
+    size_t	histogram[buckets];
+
+    LineSizeModel & operator =(LineSizeModel const &);
+    LineSizeModel(LineSizeModel const &);
+
+    static size_t touchedBytes(const Line &l) {
+      size_t n = 0;
+      for (size_t w = 0; w < maxLineSize / 64; w++) n += __builtin_popcountll(l.touched[w]);
+      return n;
+    }
+
+    void retire(const Line &l) {
+      if (l.tag == 0) return;
+      size_t n = touchedBytes(l);
+      histogram[(n * buckets - 1) >> lineSizeLog2]++;
+      evicted++;
+      evictedTouchedBytes += n;
+    }
+
+    static void touch(Line &l, size_t first, size_t last) {
+      for (size_t w = first / 64; w <= last / 64; w++) {
+	size_t lo = (w == first / 64) ? first % 64 : 0;
+	size_t hi = (w == last  / 64) ? last  % 64 : 63;
+	uint64_t mask = (hi == 63 ? ~uint64_t(0) : (uint64_t(1) << (hi + 1)) - 1) & ~((uint64_t(1) << lo) - 1);
+	l.touched[w] |= mask;
+      }
+    }
+
+    // first and last are byte offsets within the line
+    void accessLine(size_t line, size_t first, size_t last) {
+      accesses++;
+      size_t   hashed = line ^ (line >> 13);
+      Line    *set    = &lines[(hashed % sets) * ways];
+      uint32_t need   = ((uint32_t(2) << (last >> sectorSizeLog2)) - 1) &
+	~((uint32_t(1) << (first >> sectorSizeLog2)) - 1);
+
+      size_t r = 0;
+      while (r < ways && set[r].tag != line + 1) r++;
+
+      if (r < ways) {
+	Line hit = set[r];
+	memmove(&set[1], &set[0], r * sizeof(Line));
+	set[0] = hit;
+	uint32_t missing = need & ~hit.sectors;
+	if (missing) {
+	  sectorMisses++;
+	  fetchedBytes   += size_t(__builtin_popcount(missing)) << sectorSizeLog2;
+	  set[0].sectors |= missing;
+	}
+      }
+      else {
+	misses++;
+	retire(set[ways - 1]);
+	memmove(&set[1], &set[0], (ways - 1) * sizeof(Line));
+	memset(&set[0], 0, sizeof(Line));
+	set[0].tag     = line + 1;
+	set[0].sectors = need;
+	fetchedBytes  += size_t(__builtin_popcount(need)) << sectorSizeLog2;
+      }
+      touch(set[0], first, last);
+    }
+
+  public:
+    // sectorSizeLog2 == lineSizeLog2 for a cache without sectors
+    LineSizeModel(size_t capacity, size_t lineLog2, size_t sectorLog2)
+      : lineSizeLog2(lineLog2), sectorSizeLog2(sectorLog2) {
+      sets = capacity >> lineSizeLog2 >> 4;
+      lines.resize(sets * ways);
+      clear();
+    }
+
+    void clear() {
+      accesses = misses = sectorMisses = fetchedBytes = 0;
+      evicted = evictedTouchedBytes = 0;
+      for (size_t b = 0; b < buckets; b++) histogram[b] = 0;
+      memset(&lines[0], 0, lines.size() * sizeof(Line));
+    }
+
+    // empties the cache, counting the resident lines as evicted
+    void clearLines() {
+      for (size_t i = 0; i < lines.size(); i++) retire(lines[i]);
+      memset(&lines[0], 0, lines.size() * sizeof(Line));
+    }
+
+    void access(size_t addr, size_t size) {
+      size_t lo = addr >> lineSizeLog2;
+      size_t hi = (addr + size - 1) >> lineSizeLog2;
+      for (size_t line = lo; line <= hi; line++) {
+	size_t base  = line << lineSizeLog2;
+	size_t first = (line == lo) ? addr - base : 0;
+	size_t last  = (line == hi) ? addr + size - 1 - base : (size_t(1) << lineSizeLog2) - 1;
+	accessLine(line, first, last);
+      }
+    }
+
+    // resident lines are included in the utilization as if evicted now
+    void PrintStats(std::ostream &os, std::string &name) {
+      size_t hist[buckets];
+      size_t lineCount = evicted, touchedTotal = evictedTouchedBytes;
+      for (size_t b = 0; b < buckets; b++) hist[b] = histogram[b];
+      for (size_t i = 0; i < lines.size(); i++) {
+	if (lines[i].tag == 0) continue;
+	size_t n = touchedBytes(lines[i]);
+	hist[(n * buckets - 1) >> lineSizeLog2]++;
+	lineCount++;
+	touchedTotal += n;
+      }
+
+      os << name << ", " << (size_t(1) << lineSizeLog2) << ", " << (size_t(1) << sectorSizeLog2) << ", " <<
+	accesses << ", " << misses << ", " << sectorMisses << ", " << fetchedBytes << ", " <<
+	(lineCount ? double(touchedTotal) / (lineCount << lineSizeLog2) : 0);
+      for (size_t b = 0; b < buckets; b++)
+	os << ", " << hist[b];
+      os << std::endl;
+    }
+  };
+
+  // The same access stream through equal capacity caches with 32, 64, 128
+  // and 256 B lines, and 128 and 256 B lines with 64 B sectors.
+  class LineSizeStudy {
+    std::vector<LineSizeModel*> models;
+
+    LineSizeStudy & operator =(LineSizeStudy const &);
+    LineSizeStudy(LineSizeStudy const &);
+
+  public:
+    LineSizeStudy(size_t capacity) {
+      for (size_t lineLog2 = 5; lineLog2 <= 8; lineLog2++)
+	models.push_back(new LineSizeModel(capacity, lineLog2, lineLog2));
+      models.push_back(new LineSizeModel(capacity, 7, 6));
+      models.push_back(new LineSizeModel(capacity, 8, 6));
+    }
+
+    ~LineSizeStudy() {
+      for (size_t i = 0; i < models.size(); i++) delete models[i];
+    }
+
+    void clearLines() {
+      for (size_t i = 0; i < models.size(); i++) models[i]->clearLines();
+    }
+
+    void insert(size_t addr, size_t size) {
+      for (size_t i = 0; i < models.size(); i++) models[i]->access(addr, size);
+    }
+
+    void PrintStats(std::ostream &os, std::string &name) {
+      for (size_t i = 0; i < models.size(); i++) models[i]->PrintStats(os, name);
+    }
+  };
+};	// namespace
+
+#endif /* _LINESIZE_H */
@@ -0,0 +1,140 @@
+#ifndef _MISSCLASSIFIER_H
+#define _MISSCLASSIFIER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+#include "footprint.h"
+
+namespace CacheSimulator {
+
+  // Splits the misses of a set associative cache into the three C's by
+  // running a fully associative LRU cache of equal capacity next to it:
+  //   compulsory - first reference to the line
+  //   capacity   - the fully associative cache misses as well
+  //   conflict   - only the set associative cache misses
+  // The shadow is a hash map into an intrusive LRU list, O(1) per access.
+  // Write misses that do not allocate and streaming stores are not
+  // classified. A streaming store evicts its line from the shadow as it
+  // does from the real cache, so the next miss to it is a capacity miss.
+  class MissClassifier {
+
+    struct Node {
+      size_t   line;
+      uint32_t prev, next;
+    };
+
+    size_t		capacity;
+    size_t		used;
+    uint32_t		head;		// sentinel, head.next is the MRU line
+    std::vector<Node>	nodes;
+    std::unordered_map<size_t, uint32_t> index;
+    SparseBitmap		touched;	// lines referenced so far
+
+    size_t		compulsory;
+    size_t		capacityMisses;
+    size_t		conflict;
+
+    MissClassifier & operator =(MissClassifier const &);
+    MissClassifier(MissClassifier const &);
+
+    void unlink(uint32_t n) {
+      nodes[nodes[n].prev].next = nodes[n].next;
+      nodes[nodes[n].next].prev = nodes[n].prev;
+    }
+
+    void pushFront(uint32_t n) {
+      nodes[n].prev = head;
+      nodes[n].next = nodes[head].next;
+      nodes[nodes[head].next].prev = n;
+      nodes[head].next = n;
+    }
+
+    // returns true if the line hit in the shadow, and makes it the MRU
+    bool touch(size_t line) {
+      auto it = index.find(line);
+      if (it != index.end()) {
+	unlink(it->second);
+	pushFront(it->second);
+	return true;
+      }
+
+      uint32_t n;
+      if (used < capacity)
+	n = used++;
+      else {
+	n = nodes[head].prev;
+	unlink(n);
+	index.erase(nodes[n].line);
+      }
+      nodes[n].line = line;
+      index[line]   = n;
+      pushFront(n);
+      return false;
+    }
+
+  public:
+    MissClassifier(size_t lines) : capacity(lines) {
+      nodes.resize(capacity + 1);
+      index.reserve(capacity);
+      head = capacity;
+      clear();
+    }
+
+    void clear() {
+      compulsory     = 0;
+      capacityMisses = 0;
+      conflict       = 0;
+      clearLines();
+    }
+
+    void clearLines() {
+      used = 0;
+      nodes[head].prev = nodes[head].next = head;
+      index.clear();
+      touched.clear();
+    }
+
+    // seeds the shadow with a line already resident in the real cache;
+    // call from LRU to MRU
+    void warm(size_t line) {
+      touched.insert(line);
+      touch(line);
+    }
+
+    // drops a line from the shadow; the slot of the last node is reused
+    void evict(size_t line) {
+      auto it = index.find(line);
+      if (it == index.end()) return;
+      uint32_t n = it->second;
+      unlink(n);
+      index.erase(it);
+
+      uint32_t last = --used;
+      if (n != last) {
+	nodes[n] = nodes[last];
+	nodes[nodes[n].prev].next = n;
+	nodes[nodes[n].next].prev = n;
+	index[nodes[n].line]      = n;
+      }
+    }
+
+    void access(size_t line, bool miss) {
+      bool first  = touched.insert(line);
+      bool faHit  = touch(line);
+      if (!miss) return;
+
+      if (first)       compulsory++;
+      else if (!faHit) capacityMisses++;
+      else             conflict++;
+    }
+
+    size_t getCompulsory() { return compulsory; }
+    size_t getCapacity()   { return capacityMisses; }
+    size_t getConflict()   { return conflict; }
+  };
+};	// namespace
+
+#endif /* _MISSCLASSIFIER_H */
@@ -0,0 +1,136 @@
+#ifndef _SELFPROFILE_H
+#define _SELFPROFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include <ostream>
+
+namespace CacheSimulator {
+
+  // Events and time the tool itself spends, counted per thread. Times are
+  // in TSC ticks; the phases of one thread never overlap, so their sum
+  // stays within ThreadTicks.
+  enum ProfileCounter {
+    Noted,		// analysis calls
+    Inserted,		// accesses buffered for simulation
+    Considered,		// instructions seen by the JIT
+    Instrumented,	// instructions instrumented
+    BufferFlushes,	// drains triggered by a full buffer
+    Drains,		// all drains
+    InstrumentTicks,
+    AnalysisTicks,
+    LockWaitTicks,
+    DrainTicks,
+    SimulateTicks,
+    ThreadTicks,	// lifetime of the thread
+    numProfileCounters
+  };
+
+  static inline uint64_t readTicks() {
+    uint32_t lo, hi;
+    asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return (uint64_t(hi) << 32) | lo;
+  }
+
+  static inline double wallSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+  }
+
+  // One thread's counters, padded by a cache line on both sides so that
+  // heap allocated counters of different threads never share a line.
+  struct ThreadCounters {
+    char     padBefore[64];
+    size_t   count[numProfileCounters];
+    uint64_t startTicks;	// creation, the start of the thread
+    char     padAfter[64];
+
+    ThreadCounters() : startTicks(readTicks()) { clear(); }
+
+    size_t phaseTicks() {
+      return count[InstrumentTicks] + count[AnalysisTicks] + count[LockWaitTicks] +
+	count[DrainTicks] + count[SimulateTicks];
+    }
+
+    // adds the time since creation to ThreadTicks
+    void stopClock() {
+      uint64_t now = readTicks();
+      count[ThreadTicks] += now - startTicks;
+      startTicks = now;
+    }
+
+    void clear() {
+      for (size_t i = 0; i < numProfileCounters; i++) count[i] = 0;
+    }
+
+    void add(const ThreadCounters &other) {
+      for (size_t i = 0; i < numProfileCounters; i++) count[i] += other.count[i];
+    }
+  };
+
+  // Adds the ticks spent in a scope to a counter, if enabled
+  class ScopedTicks {
+    size_t   *counter;
+    uint64_t start;
+
+  public:
+    ScopedTicks(size_t &c, bool enabled) : counter(enabled ? &c : NULL), start(enabled ? readTicks() : 0) {}
+    ~ScopedTicks() { if (counter) *counter += readTicks() - start; }
+  };
+
+  // Wall time and TSC ticks since the tool started, used to convert
+  // ticks to seconds at the end of the run. Phases are summed over threads
+  // and compared to the summed lifetime of the threads, not to wall time.
+  class OverheadReport {
+    double   startSeconds;
+    uint64_t startTicks;
+
+    void PrintPhase(std::ostream &os, const char *name, double seconds, double threadTime) {
+      os << name << ", " << seconds << ", " << (threadTime > 0 ? seconds / threadTime : 0) << std::endl;
+    }
+
+  public:
+    OverheadReport() : startSeconds(wallSeconds()), startTicks(readTicks()) {}
+
+    // siteSeconds is the wall time spent inside sites, nativeSeconds an
+    // estimate of how long the same code runs without the tool, 0 if
+    // instructions were not counted
+    void Print(std::ostream &os, ThreadCounters &total, double siteSeconds, double nativeSeconds) {
+      double wall           = wallSeconds() - startSeconds;
+      double ticksPerSecond = wall > 0 ? (readTicks() - startTicks) / wall : 1;
+      double threadTime     = total.count[ThreadTicks]     / ticksPerSecond;
+      double instrument     = total.count[InstrumentTicks] / ticksPerSecond;
+      double analysis       = total.count[AnalysisTicks]   / ticksPerSecond;
+      double lockWait       = total.count[LockWaitTicks]   / ticksPerSecond;
+      double drain          = total.count[DrainTicks]      / ticksPerSecond;
+      double simulate       = total.count[SimulateTicks]   / ticksPerSecond;
+
+      os << "phase, threadSeconds, fractionOfThreadTime" << std::endl;
+      PrintPhase(os, "threadTime",      threadTime, threadTime);
+      PrintPhase(os, "instrumentation", instrument, threadTime);
+      PrintPhase(os, "analysis",        analysis, threadTime);
+      PrintPhase(os, "lockWait",        lockWait, threadTime);
+      PrintPhase(os, "bufferDrain",     drain, threadTime);
+      PrintPhase(os, "simulation",      simulate, threadTime);
+      PrintPhase(os, "other",           threadTime - instrument - analysis - lockWait - drain - simulate, threadTime);
+
+      os << std::endl << "counter, value" << std::endl;
+      os << "wallSeconds, "            << wall << std::endl;
+      os << "siteWallSeconds, "        << siteSeconds << std::endl;
+      os << "nativeSiteSeconds, "      << nativeSeconds << std::endl;
+      os << "analysisCalls, "          << total.count[Noted] << std::endl;
+      os << "accessesBuffered, "       << total.count[Inserted] << std::endl;
+      os << "instructionsConsidered, " << total.count[Considered] << std::endl;
+      os << "instructionsInstrumented, " << total.count[Instrumented] << std::endl;
+      os << "bufferFlushes, "          << total.count[BufferFlushes] << std::endl;
+      os << "drains, "                 << total.count[Drains] << std::endl;
+      os << "simulatedAccessesPerSec, " <<
+	(drain + simulate > 0 ? total.count[Inserted] / (drain + simulate) : 0) << std::endl;
+      os << "slowdownEstimate, " << (nativeSeconds > 0 ? siteSeconds / nativeSeconds : 0) << std::endl;
+    }
+  };
+};	// namespace
+
+#endif /* _SELFPROFILE_H */
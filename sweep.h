@@ -0,0 +1,320 @@
+#ifndef _SWEEP_H
+#define _SWEEP_H
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "cachesim.h"
+#include "dram.h"
+
+namespace CacheSimulator {
+
+  enum ReplacementPolicy { LRU, FIFO, Random };
+
+  static const char *policyName(ReplacementPolicy p) {
+    return p == LRU ? "lru" : p == FIFO ? "fifo" : "random";
+  }
+
+  struct SweepConfig {
+    size_t            size;
+    size_t            ways;
+    ReplacementPolicy policy;
+    size_t            lineSize;
+  };
+
+  struct SweepResult {
+    size_t accesses, misses, writebacks;
+  };
+
+  // Parses "1M", "256K", "64" etc., 0 on error
+  static size_t parseBytes(const std::string &s) {
+    char  *end;
+    size_t n = strtoul(s.c_str(), &end, 0);
+    if      (*end == 'K') { n = KB(n); end++; }
+    else if (*end == 'M') { n = MB(n); end++; }
+    else if (*end == 'G') { n = MB(n) * 1024; end++; }
+    return *end == 0 ? n : 0;
+  }
+
+  // The cross product of sizes, associativities, policies and line sizes.
+  struct SweepGrid {
+    std::vector<size_t>            sizes;
+    std::vector<size_t>            ways;
+    std::vector<ReplacementPolicy> policies;
+    std::vector<size_t>            lineSizes;
+
+    SweepGrid() {
+      for (size_t s = KB(256); s <= MB(64); s *= 4) sizes.push_back(s);
+      for (size_t w = 1; w <= 16; w *= 2) ways.push_back(w);
+      policies.push_back(LRU); policies.push_back(FIFO); policies.push_back(Random);
+      for (size_t l = 32; l <= 256; l *= 2) lineSizes.push_back(l);
+    }
+
+    // spec is a comma separated list of name=values with names size, ways,
+    // policy and line, and values separated by ':', e.g.
+    // size=1M:8M,ways=8:16,policy=lru:random,line=64. Dimensions not in
+    // spec keep their defaults. Returns false on error.
+    bool parse(const std::string &spec) {
+      return parseKeyValues(spec, [this](const std::string &name, const std::string &values) {
+	  std::vector<std::string> items;
+	  for (size_t begin = 0; begin <= values.size(); ) {
+	    size_t end = values.find(':', begin);
+	    if (end == std::string::npos) end = values.size();
+	    items.push_back(values.substr(begin, end - begin));
+	    begin = end + 1;
+	  }
+
+	  if (name == "policy") {
+	    policies.clear();
+	    for (size_t i = 0; i < items.size(); i++) {
+	      if      (items[i] == "lru")    policies.push_back(LRU);
+	      else if (items[i] == "fifo")   policies.push_back(FIFO);
+	      else if (items[i] == "random") policies.push_back(Random);
+	      else return false;
+	    }
+	    return true;
+	  }
+
+	  std::vector<size_t> *dim = name == "size" ? &sizes : name == "ways" ? &ways : name == "line" ? &lineSizes : NULL;
+	  if (dim == NULL) return false;
+	  dim->clear();
+	  for (size_t i = 0; i < items.size(); i++) {
+	    size_t n = parseBytes(items[i]);
+	    if (n == 0) return false;
+	    dim->push_back(n);
+	  }
+	  return true;
+	});
+    }
+
+    // Returns false if a configuration does not divide into whole sets of
+    // power of two sized lines.
+    bool expand(std::vector<SweepConfig> &configs) {
+      for (size_t s = 0; s < sizes.size(); s++)
+	for (size_t w = 0; w < ways.size(); w++)
+	  for (size_t p = 0; p < policies.size(); p++)
+	    for (size_t l = 0; l < lineSizes.size(); l++) {
+	      SweepConfig c = { sizes[s], ways[w], policies[p], lineSizes[l] };
+	      if (!isPowerOfTwo(c.lineSize) || c.size % (c.ways * c.lineSize) != 0) {
+		std::cerr << "Error: " << c.size << " B cannot be split into " << c.ways <<
+		  " way sets of " << c.lineSize << " B lines" << std::endl;
+		return false;
+	      }
+	      configs.push_back(c);
+	    }
+      return true;
+    }
+  };
+
+  // A write allocate, write back cache of any geometry. Ways are kept in
+  // insertion or recency order like CacheHitCounter, as (line + 1) << 1
+  // with the dirty bit in bit 0 and 0 for an empty way.
+  class SweepCache {
+    SweepConfig         config;
+    size_t              lineSizeLog2;
+    size_t              sets;
+    size_t              setMask;	// sets - 1 if a power of two, else 0
+    std::vector<size_t> tags;
+    uint64_t            rng;
+    SweepResult         result;
+
+    void accessLine(size_t line, bool write) {
+      result.accesses++;
+      size_t  hashed = line ^ (line >> 13);
+      size_t *set    = &tags[(setMask ? hashed & setMask : hashed % sets) * config.ways];
+      size_t  tag    = (line + 1) << 1;
+
+      size_t r = 0;
+      while (r < config.ways && (set[r] & ~size_t(1)) != tag) r++;
+
+      if (r < config.ways) {
+	size_t hit = set[r] | write;
+	if (config.policy == LRU) {
+	  memmove(&set[1], &set[0], r * sizeof(size_t));
+	  r = 0;
+	}
+	set[r] = hit;
+	return;
+      }
+
+      result.misses++;
+      if (config.policy == Random && set[config.ways - 1] != 0) {
+	rng ^= rng << 13; rng ^= rng >> 7; rng ^= rng << 17;
+	r = rng % config.ways;
+      }
+      else {
+	size_t victim = set[config.ways - 1];
+	memmove(&set[1], &set[0], (config.ways - 1) * sizeof(size_t));
+	set[0] = victim;
+	r = 0;
+      }
+      if (set[r] & 1) result.writebacks++;
+      set[r] = tag | write;
+    }
+
+  public:
+    SweepCache(const SweepConfig &c) : config(c), lineSizeLog2(log2Of(c.lineSize)), rng(0x9e3779b97f4a7c15ULL) {
+      sets    = c.size / (c.ways * c.lineSize);
+      setMask = isPowerOfTwo(sets) ? sets - 1 : 0;
+      tags.assign(sets * c.ways, 0);
+      memset(&result, 0, sizeof(result));
+    }
+
+    // non-temporal stores are treated as ordinary stores
+    void access(size_t entry) {
+      size_t addr = accessAddress(entry);
+      size_t lo   = addr >> lineSizeLog2;
+      size_t hi   = (addr + accessSize(entry) - 1) >> lineSizeLog2;
+      bool   write = accessType(entry) != Read;
+      for (size_t line = lo; line <= hi; line++)
+	accessLine(line, write);
+    }
+
+    const SweepResult &getResult() { return result; }
+  };
+
+  // A captured trace, mapped read only and shared by all workers.
+  class MappedTrace {
+    void   *base;
+    size_t  bytes;
+
+    MappedTrace & operator =(MappedTrace const &);
+    MappedTrace(MappedTrace const &);
+
+  public:
+    MappedTrace() : base(MAP_FAILED), bytes(0) {}
+
+    ~MappedTrace() { if (base != MAP_FAILED) munmap(base, bytes); }
+
+    bool open(const char *fileName) {
+      int fd = ::open(fileName, O_RDONLY);
+      struct stat st;
+      if (fd < 0 || fstat(fd, &st) != 0) {
+	std::cerr << "Error: cannot open trace " << fileName << std::endl;
+	if (fd >= 0) close(fd);
+	return false;
+      }
+
+      bytes = st.st_size;
+      if (bytes > 0) base = mmap(NULL, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+      close(fd);
+      if (bytes < sizeof(traceFileMagic) || base == MAP_FAILED ||
+	  memcmp(base, traceFileMagic, sizeof(traceFileMagic)) != 0 ||
+	  (bytes - sizeof(traceFileMagic)) % sizeof(size_t) != 0) {
+	std::cerr << "Error: " << fileName << " is not a trace written by -traceFile" << std::endl;
+	return false;
+      }
+      madvise(base, bytes, MADV_WILLNEED);
+      return true;
+    }
+
+    const size_t *entries() { return (const size_t*)((char*)base + sizeof(traceFileMagic)); }
+    size_t        size()    { return (bytes - sizeof(traceFileMagic)) / sizeof(size_t); }
+  };
+
+  // Runs tasks 0..n-1 on a fixed number of threads. Tasks are dealt out
+  // round robin; a worker runs its own tasks last in first out and, once
+  // out of work, steals the oldest task of another worker. No task spawns
+  // another, so a worker is done when every queue is empty.
+  class WorkStealingPool {
+    struct Queue {
+      std::mutex         lock;
+      std::deque<size_t> tasks;
+      char               pad[64];
+    };
+
+    std::vector<Queue*> queues;
+
+    bool pop(size_t self, size_t *task) {
+      Queue *own = queues[self];
+      std::lock_guard<std::mutex> guard(own->lock);
+      if (own->tasks.empty()) return false;
+      *task = own->tasks.back();
+      own->tasks.pop_back();
+      return true;
+    }
+
+    bool steal(size_t self, size_t *task) {
+      for (size_t i = 1; i < queues.size(); i++) {
+	Queue *victim = queues[(self + i) % queues.size()];
+	std::lock_guard<std::mutex> guard(victim->lock);
+	if (victim->tasks.empty()) continue;
+	*task = victim->tasks.front();
+	victim->tasks.pop_front();
+	return true;
+      }
+      return false;
+    }
+
+    WorkStealingPool & operator =(WorkStealingPool const &);
+    WorkStealingPool(WorkStealingPool const &);
+
+  public:
+    WorkStealingPool(size_t threads) {
+      for (size_t i = 0; i < threads; i++) queues.push_back(new Queue);
+    }
+
+    ~WorkStealingPool() {
+      for (size_t i = 0; i < queues.size(); i++) delete queues[i];
+    }
+
+    template<class F> void run(size_t n, F work) {
+      for (size_t t = 0; t < n; t++)
+	queues[t % queues.size()]->tasks.push_back(t);
+
+      std::vector<std::thread> workers;
+      for (size_t w = 0; w < queues.size(); w++)
+	workers.push_back(std::thread([this, w, &work]() {
+	      size_t task;
+	      while (pop(w, &task) || steal(w, &task))
+		work(task);
+	    }));
+      for (size_t w = 0; w < workers.size(); w++) workers[w].join();
+    }
+  };
+
+  // Simulates configs over trace, batchSize configurations per task. Each
+  // task walks the trace once, feeding a chunk of it to every cache of the
+  // batch in turn so the chunk stays in the host cache.
+  static void runSweep(MappedTrace &trace, std::vector<SweepConfig> &configs,
+		       std::vector<SweepResult> &results, size_t threads, size_t batchSize) {
+    static const size_t chunkEntries = 16384;
+
+    results.resize(configs.size());
+    size_t batches = (configs.size() + batchSize - 1) / batchSize;
+
+    WorkStealingPool pool(threads);
+    pool.run(batches, [&](size_t b) {
+	size_t first = b * batchSize;
+	size_t last  = std::min(first + batchSize, configs.size());
+
+	std::vector<SweepCache*> caches;
+	for (size_t c = first; c < last; c++) caches.push_back(new SweepCache(configs[c]));
+
+	const size_t *entries = trace.entries();
+	for (size_t begin = 0; begin < trace.size(); begin += chunkEntries) {
+	  size_t end = std::min(begin + chunkEntries, trace.size());
+	  for (size_t c = 0; c < caches.size(); c++)
+	    for (size_t i = begin; i < end; i++)
+	      caches[c]->access(entries[i]);
+	}
+
+	for (size_t c = first; c < last; c++) {
+	  results[c] = caches[c - first]->getResult();
+	  delete caches[c - first];
+	}
+      });
+  }
+};	// namespace
+
+#endif /* _SWEEP_H */
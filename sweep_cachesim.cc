@@ -0,0 +1,64 @@
+// Simulates a grid of cache configurations over a trace captured with the
+// Pin tool's -traceFile knob.
+//
+//   sweep_cachesim <trace> [grid] [threads] [configsPerTask]
+//
+// grid is described at SweepGrid::parse(). Prints one CSV row per
+// configuration, in grid order.
+#include <stdlib.h>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "sweep.h"
+
+using namespace CacheSimulator;
+
+bool debugging      = false;
+bool classifyMisses = false;
+bool writeAllocate  = true;
+
+int main(int argc, char* argv[])
+{
+  if (argc < 2) {
+    std::cerr << "usage: " << argv[0] << " <trace> [grid] [threads] [configsPerTask]" << std::endl;
+    return -1;
+  }
+
+  SweepGrid grid;
+  if (argc > 2 && !grid.parse(argv[2])) {
+    std::cerr << "Error: cannot parse grid " << argv[2] << std::endl;
+    return -1;
+  }
+  std::vector<SweepConfig> configs;
+  if (!grid.expand(configs)) return -1;
+
+  size_t threads   = argc > 3 ? strtoul(argv[3], NULL, 0) : std::thread::hardware_concurrency();
+  size_t batchSize = argc > 4 ? strtoul(argv[4], NULL, 0) : 4;
+  if (threads == 0)   threads = 1;
+  if (batchSize == 0) batchSize = 1;
+
+  MappedTrace trace;
+  if (!trace.open(argv[1])) return -1;
+
+  std::vector<SweepResult> results;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  runSweep(trace, configs, results, threads, batchSize);
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  std::cerr << configs.size() << " configurations over " << trace.size() << " accesses in " <<
+    seconds << " s on " << threads << " threads" << std::endl;
+
+  std::cout << "size_bytes,ways,policy,line_bytes,accesses,misses,miss_ratio,writebacks,"
+    "fill_bytes,writeback_bytes" << std::endl;
+  for (size_t i = 0; i < configs.size(); i++) {
+    SweepConfig &c = configs[i];
+    SweepResult &r = results[i];
+    std::cout << c.size << "," << c.ways << "," << policyName(c.policy) << "," << c.lineSize << "," <<
+      r.accesses << "," << r.misses << "," << (r.accesses ? double(r.misses) / r.accesses : 0) << "," <<
+      r.writebacks << "," << r.misses * c.lineSize << "," << r.writebacks * c.lineSize << std::endl;
+  }
+
+  return 0;
+}
@@ -0,0 +1,111 @@
+// Known-answer checks of the cache checkpoint format.
+#include <assert.h>
+#include <stdio.h>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "cachesim.h"
+
+using namespace CacheSimulator;
+
+bool debugging      = false;
+bool classifyMisses = false;
+bool writeAllocate  = true;
+
+// 64 sets of 16 ways; with hashed == line, line k lands in set k % 64
+static const size_t cacheBytes = KB(64);
+static const size_t sets       = 64;
+
+static std::string traffic(CacheHitCounter &counter) {
+  std::ostringstream os;
+  counter.PrintTraffic(os);
+  return os.str();
+}
+
+// resident lines and their dirty bits survive a save and load
+static void roundTrip() {
+  CacheHitCounter original;
+  original.initialize(cacheBytes);
+  for (size_t line = 0; line < 100; line++)
+    original.insert(line, line, line == 0 ? Write : Read);
+
+  FILE *fp = tmpfile();
+  assert(original.save(fp));
+  rewind(fp);
+
+  CacheHitCounter restored;
+  restored.initialize(cacheBytes);
+  assert(restored.load(fp));
+  fclose(fp);
+
+  for (size_t line = 0; line < 100; line++)
+    restored.insert(line, line, Read);
+  assert(restored.getHits() == 100);
+
+  // set 0 holds lines 0 and 64; 16 new lines push both out, and line 0
+  // is still dirty
+  for (size_t k = 2; k <= 17; k++)
+    restored.insert(k * sets, k * sets, Read);
+  assert(traffic(restored) == ", 0, 1024, 64, 0, 0");
+}
+
+static void geometryMismatch() {
+  CacheHitCounter small;
+  small.initialize(cacheBytes);
+  FILE *fp = tmpfile();
+  assert(small.save(fp));
+  rewind(fp);
+
+  CacheHitCounter large;
+  large.initialize(2 * cacheBytes);
+  std::streambuf *err = std::cerr.rdbuf(NULL);
+  assert(!large.load(fp));
+  std::cerr.rdbuf(err);
+  fclose(fp);
+}
+
+// a partially filled cache stores only its valid ways
+static void compactSets() {
+  CacheHitCounter counter;
+  counter.initialize(cacheBytes);
+  counter.insert(5, 5, Read);
+
+  FILE *fp = tmpfile();
+  assert(counter.save(fp));
+  long expected = 2 * sizeof(uint64_t) + sets * sizeof(uint8_t) + sizeof(size_t);
+  assert(ftell(fp) == expected);
+  fclose(fp);
+}
+
+static void profileRoundTrip() {
+  CacheHitProfile profile(false);
+  profile.insert(42, Read);
+
+  FILE *fp = tmpfile();
+  assert(profile.save(fp));
+  rewind(fp);
+  CacheHitProfile restored(false);
+  assert(restored.load(fp));
+
+  // a wrong config count is rejected
+  rewind(fp);
+  uint32_t configs = 2;
+  fwrite(&configs, sizeof(configs), 1, fp);
+  rewind(fp);
+  std::streambuf *err = std::cerr.rdbuf(NULL);
+  assert(!restored.load(fp));
+  std::cerr.rdbuf(err);
+  fclose(fp);
+}
+
+int main()
+{
+  roundTrip();
+  geometryMismatch();
+  compactSets();
+  profileRoundTrip();
+
+  std::cout << "test_checkpoint: ok" << std::endl;
+  return 0;
+}
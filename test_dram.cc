@@ -0,0 +1,111 @@
+// Known-answer checks of the DRAM address mapping and row buffer model.
+#include <assert.h>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "dram.h"
+
+using namespace CacheSimulator;
+
+// reads, writes, rowHitRate, rowEmpty, bankConflicts of the report row
+static std::string rows(DramModel &dram) {
+  std::ostringstream os;
+  std::string    name("site");
+  TimingEstimate timing;
+  dram.PrintStats(os, name, 0, 0, timing);
+  std::string row = os.str();
+  size_t begin = std::string("site, 0, 0, ").size();
+  size_t end   = begin;
+  for (size_t fields = 0; fields < 5; fields++) end = row.find(", ", end) + 2;
+  return row.substr(begin, end - 2 - begin);
+}
+
+// one channel and rank, two banks of two line rows: line bits are
+// column, bank, then row
+static DramConfig small(const char *spec) {
+  DramConfig config;
+  bool ok = config.parse(std::string("channels=1,ranks=1,banks=2,rowBytes=128,") + spec);
+  assert(ok);
+  return config;
+}
+
+static void openPage() {
+  DramConfig config = small("xor=0");
+  DramModel  dram(config);
+  dram.access(0, false);	// bank 0, row 0: empty
+  dram.access(1, false);	// bank 0, row 0: hit
+  dram.access(2, true);		// bank 1, row 0: empty
+  dram.access(4, false);	// bank 0, row 1: conflict
+  dram.access(0, false);	// bank 0, row 0: conflict
+  assert(rows(dram) == "4, 1, 0.2, 2, 2");
+
+  dram.clearBanks();
+  dram.access(0, false);
+  assert(rows(dram) == "5, 1, 0.166667, 3, 2");
+}
+
+// xor interleaving moves row 1 of bank 0 to bank 1
+static void xorBanks() {
+  DramConfig config = small("xor=1");
+  DramModel  dram(config);
+  dram.access(0, false);
+  dram.access(4, false);
+  assert(rows(dram) == "2, 0, 0, 2, 0");
+}
+
+// bank bits below the column put consecutive lines in different banks
+static void mapping() {
+  DramConfig config = small("xor=0,map=ba:co:ch:ra:ro");
+  DramModel  dram(config);
+  dram.access(0, false);	// bank 0
+  dram.access(1, false);	// bank 1
+  dram.access(2, false);	// bank 0, column 1
+  assert(rows(dram) == "3, 0, 0.333333, 2, 0");
+}
+
+// a rejected spec may leave the config half set, so each gets a fresh one
+static bool parses(const char *spec) {
+  DramConfig config;
+  return config.parse(spec);
+}
+
+static void parse() {
+  assert(!parses("channels=3"));
+  assert(!parses("rowBytes=32"));
+  assert(!parses("map=co:ch:ba:ra"));
+  assert(!parses("map=co:ch:ba:ro:ra"));
+  assert(!parses("map=co:co:ba:ra:ro"));
+  assert(!parses("speed=1"));
+
+  DramConfig config;
+  assert(config.parse("channels=4,mtps=4800"));
+  assert(config.peakBytesPerSecond() == 4 * 4800e6 * 8);
+}
+
+// the time comes from the busiest thread, not from all threads together
+static void bandwidth() {
+  DramConfig config;
+  DramModel  dram(config);
+  for (size_t line = 0; line < 1000; line++) dram.access(line, false);
+
+  TimingEstimate timing;
+  assert(timing.parse("ipc=1,ghz=1"));
+  std::ostringstream os;
+  std::string name("site");
+  dram.PrintStats(os, name, 4000, 1000, timing);
+  // 64000 B in 1000 ns
+  assert(os.str().find(", 16000, 64, ") != std::string::npos);
+}
+
+int main()
+{
+  openPage();
+  xorBanks();
+  mapping();
+  parse();
+  bandwidth();
+
+  std::cout << "test_dram: ok" << std::endl;
+  return 0;
+}
@@ -0,0 +1,74 @@
+// Known-answer checks of the footprint counters and the switch from exact
+// sets to HyperLogLog.
+#include <assert.h>
+#include <math.h>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "footprint.h"
+
+using namespace CacheSimulator;
+
+static std::string stats(Footprint &footprint) {
+  std::ostringstream os;
+  std::string name("site");
+  footprint.PrintStats(os, name);
+  return os.str();
+}
+
+static void sparseBitmap() {
+  SparseBitmap bitmap;
+  assert(bitmap.insert(3));
+  assert(!bitmap.insert(3));
+  assert(bitmap.insert(size_t(1) << 40));
+  assert(bitmap.size() == 2);
+  assert(bitmap.memoryBytes() == 2 * 4096);
+
+  size_t sum = 0;
+  bitmap.forEach([&sum](size_t key) { sum += key; });
+  assert(sum == 3 + (size_t(1) << 40));
+}
+
+// lines, 4 KB pages and 2 MB pages, split into reads and writes
+static void exact() {
+  Footprint footprint(size_t(1) << 20);
+  for (size_t line = 0; line < 1000; line++) footprint.insert(line, false);
+  for (size_t line = 0; line < 100;  line++) footprint.insert(line, true);
+  footprint.insert(size_t(1) << 15, false);	// the next 2 MB page
+  assert(stats(footprint) == "site, 1001, 17, 2, 1001, 100, exact\n");
+}
+
+// past the limit the line counts become estimates seeded with the lines
+// seen so far; page counts stay exact
+static void estimated() {
+  // one 4 KB leaf each for lines and read lines fits, two do not
+  Footprint footprint(3 * 4096);
+  footprint.insert(0, false);
+  footprint.insert(size_t(1) << 15, false);
+  assert(stats(footprint) == "site, 2, 2, 2, 2, 0, estimated\n");
+
+  const size_t distinct = 100000;
+  for (size_t line = 0; line < distinct; line++) footprint.insert(line * 7, false);
+  assert(fabs(double(footprint.getLines()) - distinct) < 0.02 * distinct);
+}
+
+static void hyperLogLog() {
+  HyperLogLog hll;
+  for (size_t key = 0; key < 1000000; key++) {
+    hll.insert(key);
+    hll.insert(key);
+  }
+  assert(fabs(hll.estimate() - 1e6) < 0.03 * 1e6);
+}
+
+int main()
+{
+  sparseBitmap();
+  exact();
+  estimated();
+  hyperLogLog();
+
+  std::cout << "test_footprint: ok" << std::endl;
+  return 0;
+}
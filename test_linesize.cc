@@ -0,0 +1,78 @@
+// Known-answer checks of the line size models and their utilization
+// histogram.
+#include <assert.h>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "linesize.h"
+
+using namespace CacheSimulator;
+
+static std::string stats(LineSizeModel &model) {
+  std::ostringstream os;
+  std::string name("site");
+  model.PrintStats(os, name);
+  return os.str();
+}
+
+// 128 B lines of two 64 B sectors: a tag hit can miss on the sector, and
+// only the sectors needed are fetched
+static void sectors() {
+  LineSizeModel model(1 << 16, 7, 6);
+  model.access(0, 8);		// miss, sector 0
+  model.access(64, 8);		// sector miss
+  model.access(256, 128);	// miss, both sectors
+  assert(stats(model) == "site, 128, 64, 3, 2, 1, 256, 0.5625, 1, 0, 0, 0, 0, 0, 0, 1\n");
+}
+
+// eighths are inclusive at the top: 16 of 128 bytes is the first bucket,
+// 17 the second
+static void buckets() {
+  LineSizeModel model(1 << 16, 7, 7);
+  model.access(0, 16);
+  model.access(128, 17);
+  model.access(256, 64);
+  model.access(384, 65);
+  assert(stats(model) == "site, 128, 128, 4, 4, 0, 512, 0.316406, 1, 1, 0, 1, 1, 0, 0, 0\n");
+}
+
+// an access spanning two lines touches the tail of one and the head of
+// the next; evicted lines keep their count
+static void spanAndEvict() {
+  // one set of 16 ways of 64 B lines
+  LineSizeModel model(1024, 6, 6);
+  model.access(60, 8);
+  for (size_t i = 2; i <= 16; i++) model.access(i * 64, 64);
+  assert(stats(model) == "site, 64, 64, 17, 17, 0, 1088, 0.889706, 2, 0, 0, 0, 0, 0, 0, 15\n");
+
+  model.clearLines();
+  assert(stats(model) == "site, 64, 64, 17, 17, 0, 1088, 0.889706, 2, 0, 0, 0, 0, 0, 0, 15\n");
+}
+
+static void study() {
+  LineSizeStudy lineStudy(1 << 16);
+  lineStudy.insert(0, 8);
+
+  std::ostringstream os;
+  std::string name("site");
+  lineStudy.PrintStats(os, name);
+  assert(os.str() ==
+	 "site, 32, 32, 1, 1, 0, 32, 0.25, 0, 1, 0, 0, 0, 0, 0, 0\n"
+	 "site, 64, 64, 1, 1, 0, 64, 0.125, 1, 0, 0, 0, 0, 0, 0, 0\n"
+	 "site, 128, 128, 1, 1, 0, 128, 0.0625, 1, 0, 0, 0, 0, 0, 0, 0\n"
+	 "site, 256, 256, 1, 1, 0, 256, 0.03125, 1, 0, 0, 0, 0, 0, 0, 0\n"
+	 "site, 128, 64, 1, 1, 0, 64, 0.0625, 1, 0, 0, 0, 0, 0, 0, 0\n"
+	 "site, 256, 64, 1, 1, 0, 64, 0.03125, 1, 0, 0, 0, 0, 0, 0, 0\n");
+}
+
+int main()
+{
+  sectors();
+  buckets();
+  spanAndEvict();
+  study();
+
+  std::cout << "test_linesize: ok" << std::endl;
+  return 0;
+}
@@ -0,0 +1,116 @@
+// Known-answer checks of the three C's miss classification.
+#include <assert.h>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "cachesim.h"
+
+using namespace CacheSimulator;
+
+bool debugging      = false;
+bool classifyMisses = false;
+bool writeAllocate  = true;
+
+static std::string missClasses(CacheHitCounter &counter) {
+  std::ostringstream os;
+  counter.PrintMissClasses(os);
+  return os.str();
+}
+
+// 8 MB of 16 way sets; line k << 26 hashes to set 0 for every k
+static size_t sameSet(size_t k) { return k << 26; }
+
+static void insert(CacheHitCounter &counter, size_t line, AccessType type) {
+  counter.insert(line, line ^ (line >> 13), type);
+}
+
+// 17 lines cycled through one 16 way set miss every time, but fit easily
+// in the fully associative shadow
+static void conflict() {
+  CacheHitCounter counter;
+  counter.initialize(MB(8));
+  counter.enableMissClassification();
+
+  for (size_t round = 0; round < 3; round++)
+    for (size_t k = 1; k <= 17; k++)
+      insert(counter, sameSet(k), Read);
+  assert(missClasses(counter) == ", 8, 17, 0, 34");
+}
+
+// 5 lines cycled through a 4 line shadow miss there too
+static void capacity() {
+  MissClassifier classifier(4);
+  for (size_t round = 0; round < 2; round++)
+    for (size_t line = 1; line <= 5; line++)
+      classifier.access(line, true);
+  assert(classifier.getCompulsory() == 5);
+  assert(classifier.getCapacity()   == 5);
+  assert(classifier.getConflict()   == 0);
+}
+
+// hits keep lines in the shadow; warm lines are not compulsory
+static void hitsAndWarm() {
+  MissClassifier classifier(2);
+  classifier.warm(1);
+  classifier.access(2, true);
+  classifier.access(1, false);
+  classifier.access(3, true);	// evicts 2 from the shadow
+  classifier.access(1, true);
+  classifier.access(2, true);
+  assert(classifier.getCompulsory() == 2);
+  assert(classifier.getCapacity()   == 1);
+  assert(classifier.getConflict()   == 1);
+}
+
+// a write miss that does not allocate stays out of the shadow, so the
+// first read of the line is still compulsory
+static void noWriteAllocate() {
+  writeAllocate = false;
+  CacheHitCounter counter;
+  counter.initialize(MB(8));
+  counter.enableMissClassification();
+
+  insert(counter, sameSet(1), Write);
+  insert(counter, sameSet(1), Read);
+  assert(missClasses(counter) == ", 8, 1, 0, 0");
+  writeAllocate = true;
+}
+
+// a streaming store evicts the line from the shadow too, so reading it
+// again misses in both: capacity, not conflict
+static void streamingStore() {
+  CacheHitCounter counter;
+  counter.initialize(MB(8));
+  counter.enableMissClassification();
+
+  insert(counter, sameSet(1), Read);
+  insert(counter, sameSet(1), NonTemporalWrite);
+  insert(counter, sameSet(1), Read);
+  assert(missClasses(counter) == ", 8, 1, 1, 0");
+
+  // lines moved into the freed shadow slot stay reachable
+  MissClassifier classifier(3);
+  for (size_t line = 1; line <= 3; line++) classifier.access(line, true);
+  classifier.evict(1);
+  classifier.access(4, true);
+  classifier.access(3, false);
+  classifier.access(2, false);
+  classifier.access(5, true);	// evicts 4
+  classifier.access(4, true);
+  assert(classifier.getCompulsory() == 5);
+  assert(classifier.getCapacity()   == 1);
+  assert(classifier.getConflict()   == 0);
+}
+
+int main()
+{
+  conflict();
+  capacity();
+  hitsAndWarm();
+  noWriteAllocate();
+  streamingStore();
+
+  std::cout << "test_missclassifier: ok" << std::endl;
+  return 0;
+}
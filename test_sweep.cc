@@ -0,0 +1,183 @@
+// Known-answer checks of the sweep cache policies, grid and thread pool.
+#include <assert.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "sweep.h"
+
+using namespace CacheSimulator;
+
+bool debugging      = false;
+bool classifyMisses = false;
+bool writeAllocate  = true;
+
+static size_t entry(size_t line, AccessType type = Read, size_t size = 8) {
+  return packAccess(line * 64, size, type);
+}
+
+// one set of four 64 B lines
+static SweepResult run(ReplacementPolicy policy, const std::vector<size_t> &entries) {
+  SweepConfig config = { 256, 4, policy, 64 };
+  SweepCache  cache(config);
+  for (size_t i = 0; i < entries.size(); i++) cache.access(entries[i]);
+  return cache.getResult();
+}
+
+// A B C D A E A: LRU evicts B for E and keeps A; FIFO evicts A, the oldest
+static void policies() {
+  size_t lines[] = { 1, 2, 3, 4, 1, 5, 1 };
+  std::vector<size_t> entries;
+  for (size_t i = 0; i < 7; i++) entries.push_back(entry(lines[i]));
+
+  assert(run(LRU,  entries).misses == 5);
+  assert(run(FIFO, entries).misses == 6);
+
+  // random never evicts before the set is full, nor the line it just filled
+  SweepResult random = run(Random, entries);
+  assert(random.accesses == 7 && random.misses >= 5 && random.misses <= 6);
+
+  // with a single line all three are the same
+  for (size_t p = 0; p < 3; p++) {
+    SweepConfig config = { 64, 1, ReplacementPolicy(p), 64 };
+    SweepCache  cache(config);
+    for (size_t i = 0; i < entries.size(); i++) cache.access(entries[i]);
+    assert(cache.getResult().misses == 7);
+  }
+}
+
+// dirty lines are written back once, when evicted
+static void writebacks() {
+  std::vector<size_t> entries;
+  entries.push_back(entry(1, Write));
+  entries.push_back(entry(1, Read));
+  entries.push_back(entry(2, NonTemporalWrite));
+  for (size_t line = 3; line <= 6; line++) entries.push_back(entry(line));
+
+  SweepResult lru = run(LRU, entries);
+  assert(lru.misses == 6 && lru.writebacks == 2);
+}
+
+// an access spanning two lines touches both
+static void spans() {
+  SweepConfig config = { 1024, 4, LRU, 32 };
+  SweepCache  cache(config);
+  cache.access(packAccess(28, 8, Read));
+  cache.access(packAccess(0, 64, Read));
+  assert(cache.getResult().accesses == 4 && cache.getResult().misses == 2);
+}
+
+static void grid() {
+  SweepGrid defaults;
+  std::vector<SweepConfig> configs;
+  assert(defaults.expand(configs) && configs.size() == 300);
+
+  SweepGrid custom;
+  assert(custom.parse("size=1M:8M,ways=16,policy=lru:random,line=64"));
+  configs.clear();
+  assert(custom.expand(configs) && configs.size() == 4);
+  assert(configs[0].size == MB(1) && configs[0].policy == LRU);
+  assert(configs[3].size == MB(8) && configs[3].policy == Random && configs[3].ways == 16);
+
+  SweepGrid bad;
+  assert(!bad.parse("size=1X"));
+  assert(!bad.parse("policy=mru"));
+  assert(!bad.parse("assoc=4"));
+
+  SweepGrid uneven;
+  assert(uneven.parse("size=1000,ways=4,line=64"));
+  configs.clear();
+  std::streambuf *err = std::cerr.rdbuf(NULL);
+  assert(!uneven.expand(configs));
+  std::cerr.rdbuf(err);
+}
+
+static void pool() {
+  const size_t tasks = 1000;
+  std::vector<std::atomic<int> > runs(tasks);
+  for (size_t t = 0; t < tasks; t++) runs[t] = 0;
+
+  WorkStealingPool workers(4);
+  workers.run(tasks, [&runs](size_t t) { runs[t]++; });
+  for (size_t t = 0; t < tasks; t++) assert(runs[t] == 1);
+}
+
+static std::string writeTrace(const std::vector<size_t> &entries) {
+  char name[] = "/tmp/test_sweep_XXXXXX";
+  int fd = mkstemp(name);
+  assert(fd >= 0);
+  FILE *fp = fdopen(fd, "wb");
+  fwrite(traceFileMagic, sizeof(traceFileMagic), 1, fp);
+  fwrite(&entries[0], sizeof(size_t), entries.size(), fp);
+  fclose(fp);
+  return name;
+}
+
+// any thread count and batch size gives the results of serial runs
+static void sweep() {
+  std::vector<size_t> entries;
+  size_t x = 12345;
+  for (size_t i = 0; i < 50000; i++) {
+    x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+    entries.push_back(packAccess((x >> 20) % MB(2), 8, (x >> 60) & 1));
+  }
+  std::string name = writeTrace(entries);
+
+  MappedTrace trace;
+  assert(trace.open(name.c_str()) && trace.size() == entries.size());
+
+  SweepGrid grid;
+  assert(grid.parse("size=16K:64K,ways=1:4,line=32:64"));
+  std::vector<SweepConfig> configs;
+  assert(grid.expand(configs));
+
+  std::vector<SweepResult> serial;
+  for (size_t c = 0; c < configs.size(); c++) {
+    SweepCache cache(configs[c]);
+    for (size_t i = 0; i < entries.size(); i++) cache.access(entries[i]);
+    serial.push_back(cache.getResult());
+  }
+
+  size_t threads[] = { 1, 3, 8 }, batches[] = { 1, 5, 100 };
+  for (size_t t = 0; t < 3; t++) {
+    std::vector<SweepResult> results;
+    runSweep(trace, configs, results, threads[t], batches[t]);
+    for (size_t c = 0; c < configs.size(); c++) {
+      assert(results[c].accesses   == serial[c].accesses);
+      assert(results[c].misses     == serial[c].misses);
+      assert(results[c].writebacks == serial[c].writebacks);
+    }
+  }
+  unlink(name.c_str());
+}
+
+static void badTraces() {
+  std::streambuf *err = std::cerr.rdbuf(NULL);
+  MappedTrace missing;
+  assert(!missing.open("/nonexistent/trace"));
+
+  std::vector<size_t> entries(1, entry(1));
+  std::string name = writeTrace(entries);
+  truncate(name.c_str(), sizeof(traceFileMagic) + 4);
+  MappedTrace partial;
+  assert(!partial.open(name.c_str()));
+  unlink(name.c_str());
+  std::cerr.rdbuf(err);
+}
+
+int main()
+{
+  policies();
+  writebacks();
+  spans();
+  grid();
+  pool();
+  sweep();
+  badTraces();
+
+  std::cout << "test_sweep: ok" << std::endl;
+  return 0;
+}
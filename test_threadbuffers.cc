@@ -0,0 +1,115 @@
+// Known-answer checks of the thread buffer pool, the registry of sparse
+// and reused thread ids, and draining the per-thread address stores.
+#include <assert.h>
+#include <iostream>
+#include <set>
+
+#include "addressstore.h"
+
+using namespace CacheSimulator;
+
+bool debugging      = false;
+bool classifyMisses = false;
+bool writeAllocate  = true;
+
+// released buffers come back last in, first out; new ones are distinct
+// pages, and a full arena is followed by another
+static void pool() {
+  BufferPool pool;
+  pool.initialize(100, 2, false);
+  assert(pool.getBufferSize() == 4096);
+
+  void *a = pool.acquire();
+  void *b = pool.acquire();
+  assert(a && b && a != b && (uintptr_t(a) & 4095) == 0);
+  assert(pool.getReservedBytes() == 2 * 4096);
+
+  pool.release(a);
+  pool.release(b);
+  assert(pool.getFreeBuffers() == 2);
+  assert(pool.acquire() == b);
+  assert(pool.acquire() == a);
+
+  void *c = pool.acquire();
+  assert(c && c != a && c != b);
+  assert(pool.getReservedBytes() == 4 * 4096);
+}
+
+static std::set<size_t> liveIds(ThreadBufferRegistry &registry) {
+  std::set<size_t> ids;
+  for (size_t i = 0; i < registry.size(); i++) ids.insert(registry[i]->threadId);
+  return ids;
+}
+
+// sparse ids are stored as given, and a removed id can come back with
+// the buffer its last owner released
+static void sparseIds() {
+  ThreadBufferRegistry registry;
+  registry.initialize(4, KB(4), false);
+
+  size_t tids[] = { 0, 7, 300 };
+  PerThreadAddressStore *stores[3];
+  for (size_t i = 0; i < 3; i++) stores[i] = registry.add(tids[i]);
+  assert(registry.size() == 3);
+  assert(liveIds(registry) == std::set<size_t>(tids, tids + 3));
+
+  size_t *buffer = stores[1]->getBuffer();
+  registry.remove(7);
+  assert(registry.size() == 2);
+  assert(liveIds(registry) == std::set<size_t>({ 0, 300 }));
+
+  PerThreadAddressStore *again = registry.add(7);
+  assert(again->threadId == 7 && again->getBuffer() == buffer);
+  assert(liveIds(registry) == std::set<size_t>(tids, tids + 3));
+
+  registry.remove(0);
+  registry.remove(300);
+  registry.remove(7);
+  assert(registry.size() == 0);
+}
+
+// the minimum 4 KB buffer holds 512 entries and reports full 64 early
+static void bufferFull() {
+  ThreadBufferRegistry registry;
+  registry.initialize(1, KB(4), false);
+  PerThreadAddressStore *store = registry.add(3);
+
+  for (size_t i = 1; i < 448; i++)
+    assert(!store->StoreAddress((char*)(i * 64), 8, Read, 3));
+  assert(store->StoreAddress((char*)(448 * 64), 8, Read, 3));
+}
+
+// a drain visits the live stores in registry order and skips removed ones
+static void drain() {
+  ThreadBufferRegistry registry;
+  registry.initialize(4, KB(4), false);
+
+  size_t tids[] = { 0, 7, 300 };
+  for (size_t i = 0; i < 3; i++) {
+    PerThreadAddressStore *store = registry.add(tids[i]);
+    for (size_t n = 1; n <= 2; n++)
+      store->StoreAddress((char*)(tids[i] * 1024 + n * 64), 8, Read, tids[i]);
+  }
+  registry.remove(0);	// 300 takes its place
+
+  size_t expected[] = { 300 * 1024 + 64, 300 * 1024 + 128, 7 * 1024 + 64, 7 * 1024 + 128 };
+  AddressStore drained(registry);
+  size_t entry;
+  for (size_t i = 0; i < 4; i++) {
+    assert(drained.getNextAddress(&entry));
+    assert(accessAddress(entry) == expected[i] && accessSize(entry) == 8);
+  }
+  assert(!drained.getNextAddress(&entry));
+  assert(!registry[0]->hasPendingData() && !registry[1]->hasPendingData());
+}
+
+int main()
+{
+  pool();
+  sparseIds();
+  bufferFull();
+  drain();
+
+  std::cout << "test_threadbuffers: ok" << std::endl;
+  return 0;
+}
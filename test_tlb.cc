@@ -0,0 +1,110 @@
+// Known-answer checks of the TLB hierarchy and page walk counts.
+#include <assert.h>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "tlb.h"
+
+using namespace CacheSimulator;
+
+static std::string stats(TlbHierarchy &tlb) {
+  std::ostringstream os;
+  tlb.PrintStats(os);
+  return os.str();
+}
+
+static const uint64_t base = uint64_t(1) << 40;
+
+// A cold 4K walk reads PML4E, PDPTE, PDE and PTE. The next page under the
+// same PDE finds it in the page walk cache and reads only its PTE.
+static void walks4K() {
+  TlbConfig config;
+  TlbHierarchy tlb;
+  tlb.initialize(config);
+
+  tlb.access(base, Page4K);
+  tlb.access(base + 8, Page4K);
+  tlb.access(base + 4096, Page4K);
+  assert(stats(tlb) == ", 3, 2, 2, 5");
+}
+
+// larger pages end the walk one and two levels earlier
+static void walksLargePages() {
+  TlbConfig config;
+  TlbHierarchy tlb;
+  tlb.initialize(config);
+  tlb.access(base, Page2M);
+  assert(stats(tlb) == ", 1, 1, 1, 3");
+
+  tlb.initialize(config);
+  tlb.access(base, Page1G);
+  assert(stats(tlb) == ", 1, 1, 1, 2");
+}
+
+// an L1 miss that hits in the STLB needs no walk
+static void stlbHit() {
+  TlbConfig config;
+  assert(config.parse("l1_4k=1x1,stlb=16x4"));
+  TlbHierarchy tlb;
+  tlb.initialize(config);
+
+  tlb.access(base, Page4K);
+  tlb.access(base + 4096, Page4K);
+  tlb.access(base, Page4K);
+  assert(stats(tlb) == ", 3, 3, 2, 5");
+}
+
+static void lruTagArray() {
+  TagArray tags;
+  tags.initialize(2, 2);
+  assert(!tags.access(1));
+  assert(!tags.access(2));
+  assert(tags.access(1));
+  assert(!tags.access(3));	// evicts 2
+  assert(!tags.access(2));
+  assert(!tags.access(1));	// evicted by 2
+}
+
+static void pageSizeMap() {
+  PageSizeMap map;
+  assert(map.parse("0x200000-0x400000:2M,0x40000000-0x80000000:1G"));
+  assert(map.lookup(0x1ff000)   == Page4K);
+  assert(map.lookup(0x200000)   == Page2M);
+  assert(map.lookup(0x3fffff)   == Page2M);
+  assert(map.lookup(0x400000)   == Page4K);
+  assert(map.lookup(0x50000000) == Page1G);
+  assert(!map.parse("0x400000-0x200000:2M"));
+  assert(!map.parse("0x0-0x200000:3M"));
+}
+
+// the configured scenario and the three what-ifs see the same stream
+static void model() {
+  TlbConfig   config;
+  PageSizeMap map;
+  assert(map.parse("0x10000000000-0x10000200000:2M"));
+  TlbModel tlb(config, map);
+  tlb.insert(base >> 6);
+
+  std::ostringstream os;
+  std::string name("site");
+  tlb.PrintStats(os, name);
+  assert(os.str() ==
+	 "site, configured, 1, 1, 1, 3\n"
+	 "site, all4K, 1, 1, 1, 4\n"
+	 "site, all2M, 1, 1, 1, 3\n"
+	 "site, all1G, 1, 1, 1, 2\n");
+}
+
+int main()
+{
+  walks4K();
+  walksLargePages();
+  stlbHit();
+  lruTagArray();
+  pageSizeMap();
+  model();
+
+  std::cout << "test_tlb: ok" << std::endl;
+  return 0;
+}
@@ -0,0 +1,151 @@
+// Known-answer checks of dirty lines, write allocation and the
+// write-combining buffers behind the traffic report.
+#include <assert.h>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "cachesim.h"
+
+using namespace CacheSimulator;
+
+bool debugging      = false;
+bool classifyMisses = false;
+bool writeAllocate  = true;
+
+// an 8 MB cache feeding a DRAM model
+struct Fixture {
+  DramConfig      config;
+  DramModel       dram;
+  CacheHitCounter counter;
+
+  Fixture() : dram(config) {
+    counter.initialize(MB(8));
+    counter.attachMemory(&dram);
+  }
+
+  void insert(size_t line, AccessType type, size_t offset = 0, size_t size = 8) {
+    counter.insert(line, line ^ (line >> 13), type, offset, size);
+  }
+
+  // size, fill, writeback, write-through and streaming bytes
+  std::string traffic() {
+    counter.flushWrites();
+    std::ostringstream os;
+    counter.PrintTraffic(os);
+    return os.str();
+  }
+
+  // DRAM reads and writes
+  std::string memory() {
+    std::ostringstream os;
+    std::string    name("site");
+    TimingEstimate timing;
+    dram.PrintStats(os, name, 0, 0, timing);
+    std::string row   = os.str();
+    size_t      begin = std::string("site, 0, 0, ").size();
+    return row.substr(begin, row.find(", ", row.find(", ", begin) + 2) - begin);
+  }
+};
+
+// 8 MB of 16 way sets; line k << 26 hashes to set 0 for every k
+static size_t sameSet(size_t k) { return k << 26; }
+
+// a line filled by eight streaming stores leaves as one write
+static void fullLine() {
+  Fixture f;
+  for (size_t offset = 0; offset < 64; offset += 8) f.insert(5, NonTemporalWrite, offset);
+  assert(f.traffic() == ", 8, 0, 0, 0, 64");
+  assert(f.memory() == "0, 1");
+}
+
+// five lines through four buffers: each store after the fourth line
+// drains the oldest buffer, so every line is written twice
+static void bufferReuse() {
+  Fixture f;
+  for (size_t offset = 0; offset < 16; offset += 8)
+    for (size_t line = 1; line <= 5; line++) f.insert(line, NonTemporalWrite, offset);
+  assert(f.traffic() == ", 8, 0, 0, 0, 80");
+  assert(f.memory() == "0, 10");
+}
+
+// the bytes of both store kinds are counted, each in its own write
+static void mixedLine() {
+  writeAllocate = false;
+  Fixture f;
+  f.insert(5, Write, 0);
+  f.insert(5, NonTemporalWrite, 8);
+  assert(f.traffic() == ", 8, 0, 0, 8, 8");
+  assert(f.memory() == "0, 2");
+  writeAllocate = true;
+}
+
+// a normal access drains the buffer of its line before it misses
+static void drainOnAccess() {
+  Fixture f;
+  f.insert(5, NonTemporalWrite, 0, 4);
+  f.insert(5, Read);
+  assert(f.memory() == "1, 1");
+  assert(f.traffic() == ", 8, 64, 0, 0, 4");
+}
+
+// a write hit marks the line dirty; it is written back once on eviction
+static void writeback() {
+  Fixture f;
+  f.insert(sameSet(1), Read);
+  f.insert(sameSet(1), Write);
+  for (size_t k = 2; k <= 17; k++) f.insert(sameSet(k), Read);
+  assert(f.traffic() == ", 8, 1088, 64, 0, 0");
+  assert(f.memory() == "17, 1");
+}
+
+// a streaming store to a dirty line writes the line back first
+static void streamDirtyLine() {
+  Fixture f;
+  f.insert(5, Write);
+  f.insert(5, NonTemporalWrite, 8);
+  assert(f.traffic() == ", 8, 64, 64, 0, 8");
+  assert(f.memory() == "1, 2");
+
+  // the line is gone, so a read misses again
+  f.insert(5, Read);
+  assert(f.counter.getHits() == 1 && f.counter.getTotalAccesses() == 3);
+}
+
+// without write allocation a write miss fills nothing, and a later read
+// of the line still misses
+static void noWriteAllocate() {
+  writeAllocate = false;
+  Fixture f;
+  f.insert(5, Write);
+  assert(f.traffic() == ", 8, 0, 0, 8, 0");
+  f.insert(5, Read);
+  f.insert(5, Write);
+  assert(f.traffic() == ", 8, 64, 0, 8, 0");
+  assert(f.counter.getHits() == 1 && f.counter.getTotalAccesses() == 3);
+  writeAllocate = true;
+}
+
+// every streaming store is one access, and a site of stores alone has a
+// hit ratio rather than 0/0
+static void accounting() {
+  Fixture f;
+  assert(f.counter.getHitRatio() == 0 && f.counter.getMissRatio() == 0);
+  for (size_t offset = 0; offset < 64; offset += 8) f.insert(5, NonTemporalWrite, offset);
+  assert(f.counter.getTotalAccesses() == 8 && f.counter.getMissRatio() == 1);
+}
+
+int main()
+{
+  fullLine();
+  bufferReuse();
+  mixedLine();
+  drainOnAccess();
+  writeback();
+  streamDirtyLine();
+  noWriteAllocate();
+  accounting();
+
+  std::cout << "test_traffic: ok" << std::endl;
+  return 0;
+}
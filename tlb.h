@@ -0,0 +1,251 @@
+#ifndef _TLB_H
+#define _TLB_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace CacheSimulator {
+
+  enum PageSize { Page4K, Page2M, Page1G, numPageSizes };
+
+  static const size_t pageShift[numPageSizes] = { 12, 21, 30 };
+  static const char*  pageSizeName[numPageSizes] = { "4K", "2M", "1G" };
+
+  // Set associative LRU tag array, kept in MRU order like CacheHitCounter.
+  // Tags are stored off by one so that 0 marks an empty way.
+  class TagArray {
+    size_t sets;
+    size_t ways;
+    std::vector<uint64_t> tags;
+
+  public:
+    TagArray() : sets(0), ways(0) {}
+
+    void initialize(size_t entries, size_t associativity) {
+      ways = std::min(associativity, entries);
+      sets = entries / ways;
+      tags.assign(sets * ways, 0);
+    }
+
+    void clear() { std::fill(tags.begin(), tags.end(), 0); }
+
+    // returns true on a hit; either way tag ends up as the MRU way
+    bool access(uint64_t tag) {
+      uint64_t *c  = &tags[(tag % sets) * ways];
+      uint64_t  pc = tag + 1;
+      for (size_t r = 0; r < ways; r++) {
+	uint64_t oldC = c[r];
+	c[r] = pc;
+	if (oldC == tag + 1) return true;
+	pc = oldC;
+      }
+      return false;
+    }
+  };
+
+  // Geometry of the TLB hierarchy and page walk caches, as entries x ways.
+  // Defaults follow a recent Intel core.
+  struct TlbConfig {
+    size_t l1Entries[numPageSizes], l1Ways[numPageSizes];
+    size_t stlbEntries, stlbWays;		// shared by 4K and 2M pages
+    size_t stlb1GEntries, stlb1GWays;
+    size_t pwcEntries, pwcWays;		// per paging structure level
+
+    TlbConfig() {
+      l1Entries[Page4K] = 64; l1Ways[Page4K] = 4;
+      l1Entries[Page2M] = 32; l1Ways[Page2M] = 4;
+      l1Entries[Page1G] = 4;  l1Ways[Page1G] = 4;
+      stlbEntries   = 1536; stlbWays   = 12;
+      stlb1GEntries = 16;   stlb1GWays = 4;
+      pwcEntries    = 32;   pwcWays    = 4;
+    }
+
+    // spec is a comma separated list of name=entriesxways, with names
+    // l1_4k, l1_2m, l1_1g, stlb, stlb_1g and pwc. Returns false on error.
+    bool parse(const std::string &spec) {
+      size_t begin = 0;
+      while (begin < spec.size()) {
+	size_t end = spec.find(',', begin);
+	if (end == std::string::npos) end = spec.size();
+
+	std::string item = spec.substr(begin, end - begin);
+	size_t eq = item.find('=');
+	size_t x  = item.find('x', eq);
+	if (eq == std::string::npos || x == std::string::npos) return false;
+
+	std::string name = item.substr(0, eq);
+	size_t entries = strtoul(item.c_str() + eq + 1, NULL, 0);
+	size_t ways    = strtoul(item.c_str() + x + 1, NULL, 0);
+	if (entries == 0 || ways == 0) return false;
+
+	if      (name == "l1_4k")   { l1Entries[Page4K] = entries; l1Ways[Page4K] = ways; }
+	else if (name == "l1_2m")   { l1Entries[Page2M] = entries; l1Ways[Page2M] = ways; }
+	else if (name == "l1_1g")   { l1Entries[Page1G] = entries; l1Ways[Page1G] = ways; }
+	else if (name == "stlb")    { stlbEntries   = entries; stlbWays   = ways; }
+	else if (name == "stlb_1g") { stlb1GEntries = entries; stlb1GWays = ways; }
+	else if (name == "pwc")     { pwcEntries    = entries; pwcWays    = ways; }
+	else return false;
+
+	begin = end + 1;
+      }
+      return true;
+    }
+  };
+
+  // Page size used for each virtual address region, 4K outside all regions.
+  class PageSizeMap {
+    struct Region {
+      uint64_t start, end;
+      PageSize size;
+      bool operator <(const Region &other) const { return start < other.start; }
+    };
+    std::vector<Region> regions;
+
+  public:
+    // spec is a comma separated list of start-end:size, e.g.
+    // 0x7f0000000000-0x7fffffffffff:2M. Returns false on error.
+    bool parse(const std::string &spec) {
+      size_t begin = 0;
+      while (begin < spec.size()) {
+	size_t end = spec.find(',', begin);
+	if (end == std::string::npos) end = spec.size();
+
+	std::string item = spec.substr(begin, end - begin);
+	size_t dash  = item.find('-');
+	size_t colon = item.find(':');
+	if (dash == std::string::npos || colon == std::string::npos || colon < dash) return false;
+
+	Region r;
+	r.start = strtoull(item.c_str(), NULL, 0);
+	r.end   = strtoull(item.c_str() + dash + 1, NULL, 0);
+	std::string size = item.substr(colon + 1);
+	if      (size == "4K") r.size = Page4K;
+	else if (size == "2M") r.size = Page2M;
+	else if (size == "1G") r.size = Page1G;
+	else return false;
+	if (r.end <= r.start) return false;
+
+	regions.push_back(r);
+	begin = end + 1;
+      }
+      std::sort(regions.begin(), regions.end());
+      return true;
+    }
+
+    PageSize lookup(uint64_t va) {
+      Region key;
+      key.start = va;
+      auto it = std::upper_bound(regions.begin(), regions.end(), key);
+      if (it == regions.begin()) return Page4K;
+      --it;
+      return va < it->end ? it->size : Page4K;
+    }
+  };
+
+  // L1 dTLBs per page size, a shared STLB and a page walk cache for each
+  // non-leaf paging structure level (PML4E, PDPTE, PDE).
+  class TlbHierarchy {
+    TagArray l1[numPageSizes];
+    TagArray stlb, stlb1G;
+    TagArray pwc[3];
+
+    size_t accesses, l1Misses, stlbMisses, walkRefs;
+
+    // memory references needed to walk to the leaf entry of va
+    size_t walk(uint64_t va, PageSize size) {
+      size_t leafLevel = 3 - size;
+      size_t refs = 1;
+      for (size_t level = leafLevel; level-- > 0; refs++)
+	if (pwc[level].access(va >> (39 - 9*level)))
+	  break;
+      return refs;
+    }
+
+  public:
+    void initialize(TlbConfig &config) {
+      for (size_t s = 0; s < numPageSizes; s++)
+	l1[s].initialize(config.l1Entries[s], config.l1Ways[s]);
+      stlb.initialize(config.stlbEntries, config.stlbWays);
+      stlb1G.initialize(config.stlb1GEntries, config.stlb1GWays);
+      for (size_t level = 0; level < 3; level++)
+	pwc[level].initialize(config.pwcEntries, config.pwcWays);
+      clear();
+    }
+
+    void clear() {
+      accesses = l1Misses = stlbMisses = walkRefs = 0;
+      clearEntries();
+    }
+
+    void clearEntries() {
+      for (size_t s = 0; s < numPageSizes; s++) l1[s].clear();
+      stlb.clear();
+      stlb1G.clear();
+      for (size_t level = 0; level < 3; level++) pwc[level].clear();
+    }
+
+    void access(uint64_t va, PageSize size) {
+      accesses++;
+      uint64_t vpn = va >> pageShift[size];
+      if (l1[size].access(vpn)) return;
+      l1Misses++;
+
+      bool hit = (size == Page1G) ? stlb1G.access(vpn) : stlb.access((vpn << 1) | size);
+      if (hit) return;
+      stlbMisses++;
+      walkRefs += walk(va, size);
+    }
+
+    void PrintStats(std::ostream &os) {
+      os << ", " << accesses << ", " << l1Misses << ", " << stlbMisses << ", " << walkRefs;
+    }
+  };
+
+  // TLB behaviour of one access stream under the configured page sizes and,
+  // as what-ifs, with every page mapped 4K, 2M or 1G.
+  class TlbModel {
+    enum { Configured = numPageSizes, numScenarios };
+
+    PageSizeMap	 &pageSizes;
+    TlbHierarchy scenario[numScenarios];
+
+    TlbModel & operator =(TlbModel const &);
+    TlbModel(TlbModel const &);
+
+  public:
+    TlbModel(TlbConfig &config, PageSizeMap &pageSizeMap) : pageSizes(pageSizeMap) {
+      for (size_t s = 0; s < numScenarios; s++)
+	scenario[s].initialize(config);
+    }
+
+    void clearEntries() {
+      for (size_t s = 0; s < numScenarios; s++)
+	scenario[s].clearEntries();
+    }
+
+    void insert(size_t cacheLine) {
+      uint64_t va = uint64_t(cacheLine) << 6;
+      scenario[Configured].access(va, pageSizes.lookup(va));
+      for (size_t s = 0; s < numPageSizes; s++)
+	scenario[s].access(va, PageSize(s));
+    }
+
+    void PrintStats(std::ostream &os, std::string &name) {
+      os << name << ", configured";
+      scenario[Configured].PrintStats(os);
+      os << std::endl;
+      for (size_t s = 0; s < numPageSizes; s++) {
+	os << name << ", all" << pageSizeName[s];
+	scenario[s].PrintStats(os);
+	os << std::endl;
+      }
+    }
+  };
+};	// namespace
+
+#endif /* _TLB_H */